@@ -1,5 +1,35 @@
 #include "bsp_usart.h"
 
+#if DEBUG_USART_RX_DMA
+static uint8_t usart_rx_dma_buf[DEBUG_USART_RX_DMA_BUF_SIZE]; // DMAѭջ
+static uint16_t usart_rx_dma_pos = 0;                         // ѽЭĶλ
+#endif
+
+// ͻλдȡڹж½УжϺѭԷ
+static uint8_t usart_tx_buf[DEBUG_USART_TX_BUF_SIZE];
+static volatile uint16_t usart_tx_head = 0; // д
+static volatile uint16_t usart_tx_tail = 0; // ȡѽӲ
+#if DEBUG_USART_TX_DMA
+static volatile uint16_t usart_tx_dma_len = 0; // DMA͵ֽ0=
+#endif
+
+#if DEBUG_USART_RS485
+// ռߣDE/REշе
+#define usart_de_on()   GPIO_SetBits(DEBUG_USART_DE_GPIO_PORT, DEBUG_USART_DE_GPIO_PIN)
+// ͷߣDE/REշлؽ
+#define usart_de_off()  GPIO_ResetBits(DEBUG_USART_DE_GPIO_PORT, DEBUG_USART_DE_GPIO_PIN)
+
+// ͻȡգȴһֽƳλĴ(TC)ͷߣжϵ
+static void usart_tx_idle(void)
+{
+	USART_ITConfig(DEBUG_USARTx, USART_IT_TC, ENABLE);
+}
+#else
+#define usart_de_on()
+#define usart_de_off()
+#define usart_tx_idle()
+#endif
+
 /**
   * @brief  ǶжϿNVIC
   * @param  
@@ -22,6 +52,221 @@ static void NVIC_Configuration(void)
 	NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
 	/* ʼNVIC */
 	NVIC_Init(&NVIC_InitStructure);
+
+#if DEBUG_USART_RX_DMA
+	/* DMAж봮жͬȼ֤߲ụռ */
+	NVIC_InitStructure.NVIC_IRQChannel = DEBUG_USART_RX_DMA_IRQ;
+	NVIC_Init(&NVIC_InitStructure);
+#endif
+
+#if DEBUG_USART_TX_DMA
+	/* DMAжͬʹôжϵȼ */
+	NVIC_InitStructure.NVIC_IRQChannel = DEBUG_USART_TX_DMA_IRQ;
+	NVIC_Init(&NVIC_InitStructure);
+#endif
+}
+
+#if DEBUG_USART_RX_DMA
+/**
+  * @brief  USARTDMA赽ڴ桢ѭģʽ/ȫж
+  * @param  
+  * @retval 
+  */
+static void USART_DMA_Config(void)
+{
+	DMA_InitTypeDef DMA_InitStructure;
+
+	// DMAʱ
+	RCC_AHBPeriphClockCmd(DEBUG_USART_DMA_CLK, ENABLE);
+
+	DMA_DeInit(DEBUG_USART_RX_DMA_CHANNEL);
+	// ԴַݼĴ
+	DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&DEBUG_USARTx->DR;
+	// Ŀַѭջ
+	DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)usart_rx_dma_buf;
+	DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+	DMA_InitStructure.DMA_BufferSize = DEBUG_USART_RX_DMA_BUF_SIZE;
+	DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+	DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+	DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+	DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+	// ѭģʽдԶصͷ
+	DMA_InitStructure.DMA_Mode = DMA_Mode_Circular;
+	DMA_InitStructure.DMA_Priority = DMA_Priority_VeryHigh;
+	DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+	DMA_Init(DEBUG_USART_RX_DMA_CHANNEL, &DMA_InitStructure);
+
+	// ȫжϣϴڿжϰݼʱЭ
+	DMA_ITConfig(DEBUG_USART_RX_DMA_CHANNEL, DMA_IT_HT | DMA_IT_TC, ENABLE);
+
+	usart_rx_dma_pos = 0;
+	DMA_Cmd(DEBUG_USART_RX_DMA_CHANNEL, ENABLE);
+}
+
+/**
+  * @brief  ȡDMAµݣЭ
+  * @param  
+  * @retval 
+  * @note   DMA/ȫжϺʹڿже
+  */
+void Usart_Rx_DMA_Poll(void)
+{
+	uint16_t pos;
+
+	// DMAǰдλ = С - ʣഫ
+	pos = DEBUG_USART_RX_DMA_BUF_SIZE - DMA_GetCurrDataCounter(DEBUG_USART_RX_DMA_CHANNEL);
+	if (pos == DEBUG_USART_RX_DMA_BUF_SIZE)
+	{
+		pos = 0;
+	}
+
+	if (pos == usart_rx_dma_pos)
+	{
+		return;
+	}
+
+	if (pos > usart_rx_dma_pos)
+	{
+		usart_rx_handler(&usart_rx_dma_buf[usart_rx_dma_pos], pos - usart_rx_dma_pos);
+	}
+	else
+	{
+		// дλѻƣν
+		usart_rx_handler(&usart_rx_dma_buf[usart_rx_dma_pos],
+		                 DEBUG_USART_RX_DMA_BUF_SIZE - usart_rx_dma_pos);
+		if (pos > 0)
+		{
+			usart_rx_handler(&usart_rx_dma_buf[0], pos);
+		}
+	}
+
+	usart_rx_dma_pos = pos;
+}
+#endif
+
+#if DEBUG_USART_TX_DMA
+/**
+  * @brief  USARTDMAڴ浽衢ģʽж
+  * @param  
+  * @retval 
+  * @note   ÿηʱڴַͳ
+  */
+static void USART_Tx_DMA_Config(void)
+{
+	DMA_InitTypeDef DMA_InitStructure;
+
+	RCC_AHBPeriphClockCmd(DEBUG_USART_DMA_CLK, ENABLE);
+
+	DMA_DeInit(DEBUG_USART_TX_DMA_CHANNEL);
+	DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&DEBUG_USARTx->DR;
+	DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)usart_tx_buf;
+	DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
+	DMA_InitStructure.DMA_BufferSize = 1;
+	DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+	DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+	DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+	DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+	DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+	DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+	DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+	DMA_Init(DEBUG_USART_TX_DMA_CHANNEL, &DMA_InitStructure);
+
+	DMA_ITConfig(DEBUG_USART_TX_DMA_CHANNEL, DMA_IT_TC, ENABLE);
+	usart_tx_dma_len = 0;
+}
+
+// DMAͻдȡλÿʼһΣԽĩβжϵ
+static void usart_tx_start(void)
+{
+	uint16_t pos = usart_tx_tail & (DEBUG_USART_TX_BUF_SIZE - 1);
+	uint16_t len = usart_tx_head - usart_tx_tail;
+
+	if (usart_tx_dma_len != 0 || len == 0)
+	{
+		return;
+	}
+	if (len > DEBUG_USART_TX_BUF_SIZE - pos)
+	{
+		len = DEBUG_USART_TX_BUF_SIZE - pos;
+	}
+
+	DMA_Cmd(DEBUG_USART_TX_DMA_CHANNEL, DISABLE);
+	DEBUG_USART_TX_DMA_CHANNEL->CMAR = (uint32_t)&usart_tx_buf[pos];
+	DEBUG_USART_TX_DMA_CHANNEL->CNDTR = len;
+	usart_tx_dma_len = len;
+	// DMAдDRTCֶͷʱһεľɱ־
+	USART_ClearFlag(DEBUG_USARTx, USART_FLAG_TC);
+	DMA_Cmd(DEBUG_USART_TX_DMA_CHANNEL, ENABLE);
+}
+
+// һDMAɣͷŻһΣжϵ
+static void usart_tx_poll(void)
+{
+	if (usart_tx_dma_len != 0 && DMA_GetFlagStatus(DEBUG_USART_TX_DMA_FLAG_TC) != RESET)
+	{
+		DMA_ClearFlag(DEBUG_USART_TX_DMA_FLAG_TC);
+		usart_tx_tail += usart_tx_dma_len;
+		usart_tx_dma_len = 0;
+		usart_tx_start();
+		if (usart_tx_dma_len == 0)
+		{
+			usart_tx_idle();
+		}
+	}
+}
+
+// DMA1ͨ4жϴ - 
+void DEBUG_USART_TX_DMA_IRQHandler(void)
+{
+	usart_tx_poll();
+}
+#else
+// ݼĴգȡһֽڣѿرTXEжϣжϵ
+static void usart_tx_poll(void)
+{
+	if (USART_GetFlagStatus(DEBUG_USARTx, USART_FLAG_TXE) == RESET)
+	{
+		return;
+	}
+	if (usart_tx_tail != usart_tx_head)
+	{
+		USART_SendData(DEBUG_USARTx, usart_tx_buf[usart_tx_tail & (DEBUG_USART_TX_BUF_SIZE - 1)]);
+		usart_tx_tail++;
+	}
+	else
+	{
+		USART_ITConfig(DEBUG_USARTx, USART_IT_TXE, DISABLE);
+		usart_tx_idle();
+	}
+}
+#endif
+
+/**
+  * @brief  ڷжϴTXEжģʽ·ͻеһֽڣ
+  *         RS-485ģʽһֽڷ(TC)ͷ
+  * @param  
+  * @retval 
+  * @note   ڴжеãDMAģʽDMAжϴ
+  */
+void Usart_Tx_IRQHandler(void)
+{
+#if !DEBUG_USART_TX_DMA
+	if (USART_GetITStatus(DEBUG_USARTx, USART_IT_TXE) != RESET)
+	{
+		usart_tx_poll();
+	}
+#endif
+#if DEBUG_USART_RS485
+	if (USART_GetITStatus(DEBUG_USARTx, USART_IT_TC) != RESET)
+	{
+		// TC־λرжϣڼдռ
+		USART_ITConfig(DEBUG_USARTx, USART_IT_TC, DISABLE);
+		if (usart_tx_tail == usart_tx_head)
+		{
+			usart_de_off();
+		}
+	}
+#endif
 }
 
 /**
@@ -51,6 +296,15 @@ void USART_Config(void)
 	GPIO_InitStructure.GPIO_Mode = GPIO_Mode_IN_FLOATING;
 	GPIO_Init(DEBUG_USART_RX_GPIO_PORT, &GPIO_InitStructure);
 
+#if DEBUG_USART_RS485
+	// RS-485ƽΪϵĬϽգռ
+	DEBUG_USART_GPIO_APBxClkCmd(DEBUG_USART_DE_GPIO_CLK, ENABLE);
+	usart_de_off();
+	GPIO_InitStructure.GPIO_Pin = DEBUG_USART_DE_GPIO_PIN;
+	GPIO_InitStructure.GPIO_Mode = GPIO_Mode_Out_PP;
+	GPIO_Init(DEBUG_USART_DE_GPIO_PORT, &GPIO_InitStructure);
+#endif
+
 	// ôڵĹ
 	// ò
 	USART_InitStructure.USART_BaudRate = DEBUG_USART_BAUDRATE;
@@ -70,24 +324,122 @@ void USART_Config(void)
 	// жȼ
 	NVIC_Configuration();
 
+#if DEBUG_USART_RX_DMA
+	// DMAģʽDMAݣֻ·ж
+	USART_DMA_Config();
+	USART_DMACmd(DEBUG_USARTx, USART_DMAReq_Rx, ENABLE);
+	USART_ITConfig(DEBUG_USARTx, USART_IT_IDLE, ENABLE);
+#else
 	// ʹܴڽж
 	USART_ITConfig(DEBUG_USARTx, USART_IT_RXNE, ENABLE);
+#endif
+
+	usart_tx_head = 0;
+	usart_tx_tail = 0;
+#if DEBUG_USART_TX_DMA
+	USART_Tx_DMA_Config();
+	USART_DMACmd(DEBUG_USARTx, USART_DMAReq_Tx, ENABLE);
+#endif
 
 	// ʹܴ
 	USART_Cmd(DEBUG_USARTx, ENABLE);
 }
 
+/**
+  * @brief  ݣ뷢ͻأDMATXEжں̨
+  * @param  buf: 
+  * @param  len: ݳ
+  * @retval 
+  * @note   жϺѭоɵãʱ͵ƶͣȴڳռ䡣
+  *         RS-485ģʽռߣжͷ
+  */
 void Usart_Send_Data(uint8_t *buf, uint8_t len)
 {
+	uint32_t primask = __get_PRIMASK();
 	uint8_t t;
+
+	__disable_irq();
+	if (len == 0)
+	{
+		__set_PRIMASK(primask);
+		return;
+	}
+	usart_de_on();
 	for (t = 0; t < len; t++)
 	{
-		while (USART_GetFlagStatus(USART1, USART_FLAG_TC) == RESET)
-			;
-		USART_SendData(USART1, buf[t]);
+		while ((uint16_t)(usart_tx_head - usart_tx_tail) >= DEBUG_USART_TX_BUF_SIZE)
+		{
+			usart_tx_poll();
+		}
+		usart_tx_buf[usart_tx_head & (DEBUG_USART_TX_BUF_SIZE - 1)] = buf[t];
+		usart_tx_head++;
+	}
+
+#if DEBUG_USART_TX_DMA
+	usart_tx_start();
+#else
+	USART_ITConfig(DEBUG_USARTx, USART_IT_TXE, ENABLE);
+#endif
+	__set_PRIMASK(primask);
+}
+
+/**
+  * @brief  ȴͻеȫһֽڵֹͣλ
+  * @param  
+  * @retval 
+  * @note   лʡתAPP͸λǰãжʱҲɡ
+  *         RS-485ģʽ·ʱͷ
+  */
+void Usart_Tx_Flush(void)
+{
+	uint32_t primask;
+
+	while (usart_tx_tail != usart_tx_head)
+	{
+		primask = __get_PRIMASK();
+		__disable_irq();
+		usart_tx_poll();
+		__set_PRIMASK(primask);
 	}
-	while (USART_GetFlagStatus(USART1, USART_FLAG_TC) == RESET)
+
+	while (USART_GetFlagStatus(DEBUG_USARTx, USART_FLAG_TC) == RESET)
 		;
+
+#if DEBUG_USART_RS485
+	primask = __get_PRIMASK();
+	__disable_irq();
+	if (usart_tx_tail == usart_tx_head)
+	{
+		USART_ITConfig(DEBUG_USARTx, USART_IT_TC, DISABLE);
+		usart_de_off();
+	}
+	__set_PRIMASK(primask);
+#endif
+}
+
+/**
+  * @brief  лڲ
+  * @param  baudrate: ²
+  * @retval 
+  * @note   ȴѷ͵ȫлDMAշжñֲ
+  */
+void Usart_Set_BaudRate(uint32_t baudrate)
+{
+	USART_InitTypeDef USART_InitStructure;
+
+	Usart_Tx_Flush();
+
+	USART_Cmd(DEBUG_USARTx, DISABLE);
+
+	USART_InitStructure.USART_BaudRate = baudrate;
+	USART_InitStructure.USART_WordLength = USART_WordLength_8b;
+	USART_InitStructure.USART_StopBits = USART_StopBits_1;
+	USART_InitStructure.USART_Parity = USART_Parity_No;
+	USART_InitStructure.USART_HardwareFlowControl = USART_HardwareFlowControl_None;
+	USART_InitStructure.USART_Mode = USART_Mode_Rx | USART_Mode_Tx;
+	USART_Init(DEBUG_USARTx, &USART_InitStructure);
+
+	USART_Cmd(DEBUG_USARTx, ENABLE);
 }
 
 /*****************  һֽ **********************/
@@ -156,12 +508,10 @@ void Usart_SendHalfWord(USART_TypeDef *pUSARTx, uint16_t ch)
 ///ضc⺯printfڣضʹprintf
 int fputc(int ch, FILE *f)
 {
-	/* һֽݵ */
-	USART_SendData(DEBUG_USARTx, (uint8_t) ch);
+	uint8_t byte = (uint8_t) ch;
 
-	/* ȴ */
-	while (USART_GetFlagStatus(DEBUG_USARTx, USART_FLAG_TXE) == RESET)
-		;
+	/* ͻЭݽ */
+	Usart_Send_Data(&byte, 1);
 
 	return (ch);
 }
@@ -10,6 +10,8 @@
 #define  DEBUG_USART_CLK                RCC_APB2Periph_USART1
 #define  DEBUG_USART_APBxClkCmd         RCC_APB2PeriphClockCmd
 #define  DEBUG_USART_BAUDRATE           115200
+// ֺЭл߲ʣUSART172MHzAPB2ϣ
+#define  DEBUG_USART_BAUDRATE_MAX       2000000
 
 // USART GPIO ź궨
 #define  DEBUG_USART_GPIO_CLK           (RCC_APB2Periph_GPIOA)
@@ -20,9 +22,40 @@
 #define  DEBUG_USART_RX_GPIO_PORT       GPIOA
 #define  DEBUG_USART_RX_GPIO_PIN        GPIO_Pin_10
 
+// RS-485 շƣ1=ǰDE/REһֽڵֹͣλ(TC) 0=
+// ϳѯĽڵⶼͷߣڵͻ
+#define  DEBUG_USART_RS485              1
+#define  DEBUG_USART_DE_GPIO_CLK        (RCC_APB2Periph_GPIOA)
+#define  DEBUG_USART_DE_GPIO_PORT       GPIOA
+#define  DEBUG_USART_DE_GPIO_PIN        GPIO_Pin_8
+
 #define  DEBUG_USART_IRQ                USART1_IRQn
 #define  DEBUG_USART_IRQHandler         USART1_IRQHandler
 
+// ڽշʽѡ1=DMAѭ(/ȫ/·ж) 0=ֽRXNEж
+#define  DEBUG_USART_RX_DMA             1
+
+// USART1_RX ̶ӳ䵽 DMA1 ͨ5
+#define  DEBUG_USART_DMA_CLK            RCC_AHBPeriph_DMA1
+#define  DEBUG_USART_RX_DMA_CHANNEL     DMA1_Channel5
+#define  DEBUG_USART_RX_DMA_IRQ         DMA1_Channel5_IRQn
+#define  DEBUG_USART_RX_DMA_IRQHandler  DMA1_Channel5_IRQHandler
+#define  DEBUG_USART_RX_DMA_IT_HT       DMA1_IT_HT5
+#define  DEBUG_USART_RX_DMA_IT_TC       DMA1_IT_TC5
+// DMAѭС/ȫһж
+#define  DEBUG_USART_RX_DMA_BUF_SIZE    256
+
+// ڷͣݷ뷢ͻλأɺ̨1=DMA 0=TXEжֽڷ
+#define  DEBUG_USART_TX_DMA             1
+// ͻλСΪ2
+#define  DEBUG_USART_TX_BUF_SIZE        256
+
+// USART1_TX ̶ӳ䵽 DMA1 ͨ4
+#define  DEBUG_USART_TX_DMA_CHANNEL     DMA1_Channel4
+#define  DEBUG_USART_TX_DMA_IRQ         DMA1_Channel4_IRQn
+#define  DEBUG_USART_TX_DMA_IRQHandler  DMA1_Channel4_IRQHandler
+#define  DEBUG_USART_TX_DMA_IT_TC       DMA1_IT_TC4
+#define  DEBUG_USART_TX_DMA_FLAG_TC     DMA1_FLAG_TC4
 
 
 void USART_Config(void);
@@ -31,5 +64,15 @@ void Usart_SendString( USART_TypeDef * pUSARTx, char *str);
 void Usart_SendHalfWord( USART_TypeDef * pUSARTx, uint16_t ch);
 
 void Usart_Send_Data(uint8_t *buf, uint8_t len);
+void Usart_Tx_Flush(void);
+void Usart_Tx_IRQHandler(void);
+void Usart_Set_BaudRate(uint32_t baudrate);
+
+#if DEBUG_USART_RX_DMA
+void Usart_Rx_DMA_Poll(void);
+
+// DMAݻصЭʵ֣жеã
+extern void usart_rx_handler(const uint8_t *data, uint16_t len);
+#endif
 
 #endif /* __USART_H */
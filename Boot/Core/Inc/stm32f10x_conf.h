@@ -29,10 +29,10 @@
 //#include "stm32f10x_bkp.h"
 //#include "stm32f10x_can.h"
 //#include "stm32f10x_cec.h"
-//#include "stm32f10x_crc.h"
+#include "stm32f10x_crc.h"
 //#include "stm32f10x_dac.h"
 //#include "stm32f10x_dbgmcu.h"
-//#include "stm32f10x_dma.h"
+#include "stm32f10x_dma.h"
 //#include "stm32f10x_exti.h"
 #include "stm32f10x_flash.h"
 //#include "stm32f10x_fsmc.h"
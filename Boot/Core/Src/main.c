@@ -38,7 +38,6 @@ int main(void)
 	// ========== 步骤1：硬件初始化 ==========
 	LED_GPIO_Config();
 	Key_GPIO_Config();
-	ymodem_init(); // Ymodem协议和UART初始化
 
 	// ========== 步骤2：读取并初始化配置 ==========
 	if (!init_system_config())
@@ -50,11 +49,16 @@ int main(void)
 		}
 	}
 
+	// 提前启动激活分区的校验：DMA计算CRC的同时初始化串口，步骤5取结果
+	firmware_verify_start(g_config.active_bank);
+	ymodem_init(); // Ymodem协议和UART初始化
+
 	// ========== 步骤3：检查按键强制升级 ==========
 	if (Key_Scan(KEY1_GPIO_PORT, KEY1_GPIO_PIN) == 1)
 	{
 		upgrade_process(); // 进入升级流程
-		// 升级失败
+		// 升级失败：取消字符发完再复位
+		Usart_Tx_Flush();
 		NVIC_SystemReset();
 	}
 
@@ -63,7 +67,8 @@ int main(void)
 	if (g_config.upgrade_status == UPGRADE_STATUS_DOWNLOADING)
 	{
 		upgrade_process(); // 重新进入升级流程
-		// 升级失败
+		// 升级失败：取消字符发完再复位
+		Usart_Tx_Flush();
 		NVIC_SystemReset();
 	}
 
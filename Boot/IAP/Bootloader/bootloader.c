@@ -87,24 +87,40 @@ uint8_t mcu_flash_erase(uint32_t addr, uint16_t sector_num)
 
 uint8_t mcu_flash_write(uint32_t addr, uint8_t *buffer, uint32_t length) 
 {
-	FLASH_Status result;
+	FLASH_Status result = FLASH_COMPLETE;
 	uint16_t i, data = 0;
+	// 半字对齐的缓冲区（数据包缓冲池、解压暂存区）直接按半字读取，否则逐字节拼接
+	uint8_t aligned = ((uint32_t)buffer & 1) == 0;
 	FLASH_Unlock();
 	for (i = 0; i < length; i += 2) 
 	{
-		data = (*(buffer + i + 1) << 8) + (*(buffer + i));
+		if (length - i == 1)
+		{
+			data = 0xFF00 | buffer[i]; // 奇数长度的最后一个字节，高字节保持擦除值
+		}
+		else if (aligned)
+		{
+			data = *(const uint16_t *)(buffer + i);
+		}
+		else
+		{
+			data = (*(buffer + i + 1) << 8) + (*(buffer + i));
+		}
+		// 擦除后的半字即为0xFFFF，不需要编程
+		if (data == 0xFFFF)
+		{
+			continue;
+		}
 		result = FLASH_ProgramHalfWord((uint32_t)(addr + i), data);
+		// 编程失败立即停止，避免后续半字的结果掩盖前面的错误
+		if (result != FLASH_COMPLETE)
+		{
+			FLASH_Lock();
+			return 0;
+		}
 	}
 	FLASH_Lock();
-
-	if(result != FLASH_COMPLETE)
-	{
-		return 0;
-	}
-	else
-	{
-		return 1;
-	}
+	return 1;
 }
 
 void mcu_flash_read(uint32_t addr, uint8_t *buffer, uint32_t length)
@@ -135,6 +151,9 @@ void jump_to_app(uint8_t bank)
 
 	LED1_OFF();
 
+	// 应答等尚在发送缓冲区中的数据发完再跳转，APP会重新初始化串口
+	Usart_Tx_Flush();
+
 	// 执行跳转
 	iap_load_app(app_addr);
 }
@@ -156,11 +175,15 @@ void upgrade_process(void)
 	firmware_info_t fw_info;
 	uint32_t target_addr;
 	uint32_t calculated_crc;
+	uint32_t hw_crc = 0;
 
 	// ========== 步骤1：确定目标分区 ==========
 	target_bank = !g_config.active_bank;
 	target_addr = (target_bank == 0) ? APP_A_SECTOR_ADDR : APP_B_SECTOR_ADDR;
 
+	// 目标分区将被改写，之前缓存的校验结果作废
+	firmware_verify_invalidate(target_bank);
+
 	// 设置升级状态为"下载中"
 	g_config.upgrade_status = UPGRADE_STATUS_DOWNLOADING;
 	config_save(&g_config);
@@ -174,13 +197,15 @@ void upgrade_process(void)
 	// 重置Ymodem状态机
 	ymodem_reset();
 
-	// 设置目标地址并启动接收
+	// 设置目标地址并启动接收（多机总线上的节点等待被选中后才握手）
 	g_ymodem_target_addr = target_addr;
-	ymodem_c();
+	ymodem_set_node_id(g_config.node_id);
+	ymodem_start();
 
-	// 等待传输完成
+	// 等待传输完成：中断只负责组帧，数据包在这里写入Flash并应答
 	while (g_ymodem_success == 0)
 	{
+		ymodem_process();
 	}
 
 	// ========== 步骤3：验证固件 ==========
@@ -191,6 +216,7 @@ void upgrade_process(void)
 	if (!firmware_parse_header(target_addr, &fw_info))
 	{
 		// 固件头部解析失败
+		ymodem_bcast_confirm(0);
 		LED1_OFF();
 		led_status_indicate(5); // 固件格式错误
 		g_config.upgrade_status = UPGRADE_STATUS_FAILED;
@@ -198,13 +224,26 @@ void upgrade_process(void)
 		return;
 	}
 
-	// 计算固件CRC32（跳过头部）
-	calculated_crc = crc32_calculate_flash(target_addr + 24, fw_info.firmware_size);
+	// 固件CRC32（跳过头部）：接收时已逐段回读比对并累计（同时累计硬件原生CRC），
+	// 累计不完整（如广播会话）时才重新读取整个固件，一次读取同时算出两者
+#if CRC32_USE_HW
+	if (!ymodem_get_crc32(fw_info.firmware_size, &calculated_crc) ||
+		!ymodem_get_hw_crc(fw_info.firmware_size, &hw_crc))
+	{
+		calculated_crc = crc32_calculate_flash_native(target_addr + 24, fw_info.firmware_size, &hw_crc);
+	}
+#else
+	if (!ymodem_get_crc32(fw_info.firmware_size, &calculated_crc))
+	{
+		calculated_crc = crc32_calculate_flash(target_addr + 24, fw_info.firmware_size);
+	}
+#endif
 
 	// 验证CRC32
 	if (calculated_crc != fw_info.firmware_crc32)
 	{
 		// CRC32校验失败
+		ymodem_bcast_confirm(0);
 		LED1_OFF();
 		led_status_indicate(2); // CRC错误
 		g_config.upgrade_status = UPGRADE_STATUS_FAILED;
@@ -227,12 +266,18 @@ void upgrade_process(void)
 		g_config.bank_b_info.is_valid = FIRMWARE_VALID_FLAG;
 	}
 
+	// 记录硬件CRC原生校验值：之后启动时由DMA把固件送入CRC单元校验，不占用CPU
+	g_config.bank_hw_crc[target_bank] = hw_crc;
+
 	// 切换激活分区
 	g_config.active_bank = target_bank;
 	g_config.boot_count = 0; // 重置启动计数器
 	g_config.upgrade_status = UPGRADE_STATUS_SUCCESS;
 	config_save(&g_config);
 
+	// 广播会话：发送方查询到校验结果后才计为升级完成
+	ymodem_bcast_confirm(1);
+
 	// ========== 步骤5：跳转到新固件 ==========
 	LED1_OFF();
 	led_fast_blink(10, 100);
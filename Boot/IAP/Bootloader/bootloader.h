@@ -12,7 +12,7 @@
 |   包含升级逻辑    |
 +-------------------+  0x08004000
 |   配置区(Config)  |  2KB   (0x08004000 - 0x08004800)
-|   存储版本/状态   |
+|   版本/状态+续传  |
 +-------------------+  0x08004800
 |   APP A区         |  20KB  (0x08004800 - 0x08009800)
 |   主应用程序      |
@@ -4,10 +4,31 @@
 #include "crc32.h"
 #include "firmware_verify.h"
 #include <string.h>
+#include <stddef.h>
 
 // 外部配置变量声明
 extern system_config_t g_config;
 
+// 断点续传日志：下一条水位记录的位置和已记录的页数，0xFFFF=日志未打开
+static uint16_t journal_next = 0xFFFF;
+static uint16_t journal_pages = 0;
+
+// 旧版配置：CRC32紧跟在前len字节之后，之后新增的字段读出后补0
+// 60字节版本没有node_id（补0即点对点节点），64字节版本没有硬件CRC记录（补0即未记录）
+static uint8_t config_read_legacy(system_config_t *config, uint32_t len)
+{
+    uint32_t crc;
+
+    memcpy(&crc, (uint8_t*)config + len, 4);
+    if (crc32_calculate((uint8_t*)config, len) != crc) {
+        return 0;
+    }
+
+    memset((uint8_t*)config + len, 0, sizeof(system_config_t) - 4 - len);
+    config->config_crc32 = crc32_calculate((uint8_t*)config, sizeof(system_config_t) - 4);
+    return 1;  // 下次保存时写入新格式
+}
+
 /**
  * @brief  读取配置区数据
  * @param  config: 配置结构体指针
@@ -26,7 +47,9 @@ uint8_t config_read(system_config_t *config)
     // 验证CRC32
     uint32_t crc = crc32_calculate((uint8_t*)config,sizeof(system_config_t) - 4); // 减去crc32字段本身
     if (crc != config->config_crc32) {
-        return 0;  // CRC校验失败
+        // 可能是旧版配置，否则CRC校验失败
+        return config_read_legacy(config, offsetof(system_config_t, bank_hw_crc)) ||
+               config_read_legacy(config, offsetof(system_config_t, node_id));
     }
 
     return 1;  // 配置有效
@@ -45,8 +68,8 @@ uint8_t config_save(system_config_t *config)
     config->config_crc32 = crc32_calculate((uint8_t*)config,
                                           sizeof(system_config_t) - 4);
 
-    // 擦除配置区（2KB = 2个扇区）
-    result = mcu_flash_erase(CONFIG_AREA_ADDR, CONFIG_AREA_SIZE / FLASH_SECTOR_SIZE);
+    // 只擦除配置区第一页，第二页为断点续传日志
+    result = mcu_flash_erase(CONFIG_AREA_ADDR, 1);
     if (!result) {
         return 0;
     }
@@ -59,6 +82,122 @@ uint8_t config_save(system_config_t *config)
     return result;
 }
 
+/**
+ * @brief  查找可续传的下载
+ * @param  file_id: 文件标识
+ * @param  file_size: 文件大小
+ * @param  target_addr: 写入的分区地址
+ * @retval 已写入Flash的字节数（页对齐），0=无可续传记录
+ * @note   找到记录时日志保持打开，之后的水位继续追加在其后
+ */
+uint32_t resume_journal_find(uint32_t file_id, uint32_t file_size, uint32_t target_addr)
+{
+    const resume_journal_t *head = (const resume_journal_t *)RESUME_JOURNAL_ADDR;
+    const uint16_t *rec = (const uint16_t *)(RESUME_JOURNAL_ADDR + sizeof(resume_journal_t));
+    uint16_t i;
+
+    journal_next = 0xFFFF;
+    journal_pages = 0;
+
+    if (head->magic != RESUME_MAGIC || head->file_id != file_id ||
+        head->file_size != file_size || head->target_addr != target_addr) {
+        return 0;
+    }
+
+    // 最后一条完整的记录即为水位
+    for (i = 0; i < RESUME_MAX_RECORDS; i++) {
+        if (rec[2 * i] == 0xFFFF && rec[2 * i + 1] == 0xFFFF) {
+            break;
+        }
+        if ((rec[2 * i] ^ rec[2 * i + 1]) == 0xFFFF) {
+            journal_pages = rec[2 * i];
+        }
+    }
+    journal_next = i;
+
+    // 水位超出文件范围说明记录不可信
+    if ((uint32_t)journal_pages * FLASH_SECTOR_SIZE >= file_size) {
+        journal_pages = 0;
+    }
+    return (uint32_t)journal_pages * FLASH_SECTOR_SIZE;
+}
+
+/**
+ * @brief  开始新的下载记录（擦除日志页并写入日志头）
+ * @param  file_id: 文件标识
+ * @param  file_size: 文件大小
+ * @param  target_addr: 写入的分区地址
+ * @retval 1=成功 0=失败
+ */
+uint8_t resume_journal_open(uint32_t file_id, uint32_t file_size, uint32_t target_addr)
+{
+    resume_journal_t head;
+
+    journal_next = 0xFFFF;
+    journal_pages = 0;
+
+    head.magic = RESUME_MAGIC;
+    head.file_id = file_id;
+    head.file_size = file_size;
+    head.target_addr = target_addr;
+
+    if (!mcu_flash_erase(RESUME_JOURNAL_ADDR, 1) ||
+        !mcu_flash_write(RESUME_JOURNAL_ADDR, (uint8_t *)&head, sizeof(head))) {
+        return 0;
+    }
+    journal_next = 0;
+    return 1;
+}
+
+/**
+ * @brief  记录已写入Flash的字节数
+ * @param  written: 从分区起始已连续写入的字节数
+ * @retval None
+ * @note   只在跨过页边界时追加一条记录，不擦除；记录写满后不再更新水位。
+ *         写入失败时作废整个日志，本次下载不再记录
+ */
+void resume_journal_commit(uint32_t written)
+{
+    uint16_t pages = written / FLASH_SECTOR_SIZE;
+    uint16_t rec[2];
+
+    if (journal_next >= RESUME_MAX_RECORDS || pages <= journal_pages) {
+        return;
+    }
+
+    rec[0] = pages;
+    rec[1] = ~pages;
+    if (!mcu_flash_write(RESUME_JOURNAL_ADDR + sizeof(resume_journal_t) + journal_next * 4,
+                         (uint8_t *)rec, sizeof(rec))) {
+        // 写了一半的记录可能恰好通过反码检查，整个日志不再可信：作废，下次从头传输
+        resume_journal_close();
+        if (*(const uint32_t *)RESUME_JOURNAL_ADDR == RESUME_MAGIC) {
+            mcu_flash_erase(RESUME_JOURNAL_ADDR, 1);  // 魔术字也改写失败时擦除整页
+        }
+        return;
+    }
+    journal_next++;
+    journal_pages = pages;
+}
+
+/**
+ * @brief  作废下载记录（下载完成或分区将被其他文件覆盖时调用）
+ * @param  None
+ * @retval None
+ * @note   魔术字低半字改写为0，不需要擦除（已编程的半字允许再写入0）
+ */
+void resume_journal_close(void)
+{
+    uint16_t zero = 0;
+
+    journal_next = 0xFFFF;
+    journal_pages = 0;
+
+    if (*(const uint32_t *)RESUME_JOURNAL_ADDR == RESUME_MAGIC) {
+        mcu_flash_write(RESUME_JOURNAL_ADDR, (uint8_t *)&zero, sizeof(zero));
+    }
+}
+
 /**
  * @brief  初始化默认配置
  * @param  config: 配置结构体指针
@@ -127,6 +266,7 @@ uint8_t config_mark_firmware_valid(uint8_t bank, firmware_info_t *fw_info)
         memcpy(&config.bank_b_info, fw_info, sizeof(firmware_info_t));
         config.bank_b_info.is_valid = FIRMWARE_VALID_FLAG;
     }
+    config.bank_hw_crc[bank] = 0;  // 固件已更换，原生校验值作废
 
     // 保存配置
     return config_save(&config);
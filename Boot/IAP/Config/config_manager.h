@@ -32,6 +32,40 @@ void config_init_default(system_config_t *config);
  */
 uint8_t config_mark_firmware_valid(uint8_t bank, firmware_info_t *fw_info);
 
+// ========== 断点续传日志 ==========
+
+/**
+ * @brief  查找可续传的下载
+ * @param  file_id: 文件标识
+ * @param  file_size: 文件大小
+ * @param  target_addr: 写入的分区地址
+ * @retval 已写入Flash的字节数（页对齐），0=无可续传记录
+ */
+uint32_t resume_journal_find(uint32_t file_id, uint32_t file_size, uint32_t target_addr);
+
+/**
+ * @brief  开始新的下载记录（擦除日志页并写入日志头）
+ * @param  file_id: 文件标识
+ * @param  file_size: 文件大小
+ * @param  target_addr: 写入的分区地址
+ * @retval 1=成功 0=失败
+ */
+uint8_t resume_journal_open(uint32_t file_id, uint32_t file_size, uint32_t target_addr);
+
+/**
+ * @brief  记录已写入Flash的字节数
+ * @param  written: 从分区起始已连续写入的字节数
+ * @retval None
+ */
+void resume_journal_commit(uint32_t written);
+
+/**
+ * @brief  作废下载记录
+ * @param  None
+ * @retval None
+ */
+void resume_journal_close(void);
+
 // ========== 配置工具函数 ==========
 uint8_t init_system_config(void);
 uint8_t handle_boot_counter(void);
@@ -16,8 +16,10 @@
 #define BOOT_SECTOR_SIZE        0x4000         // 16KB
 
 // 配置区（存储版本信息、状态等）
+// 第一页存放系统配置，第二页为断点续传日志
 #define CONFIG_AREA_ADDR        0x08004000
 #define CONFIG_AREA_SIZE        0x800          // 2KB
+#define RESUME_JOURNAL_ADDR     (CONFIG_AREA_ADDR + FLASH_SECTOR_SIZE)
 
 // APP A区（主应用程序分区）
 #define APP_A_SECTOR_ADDR       0x08004800
@@ -44,7 +46,7 @@ typedef struct __attribute__((packed)) {
     uint8_t  version_major;   // 主版本号
     uint8_t  version_minor;   // 次版本号
     uint8_t  version_patch;   // 补丁版本号
-    uint8_t  reserved1;
+    uint8_t  reserved1;       // 固件包标志（FIRMWARE_FLAG_xxx），描述传输时的数据格式
     uint32_t firmware_size;   // 固件大小（字节）
     uint32_t firmware_crc32;  // 固件CRC32校验值
     uint32_t build_timestamp; // 编译时间戳
@@ -57,6 +59,18 @@ typedef struct __attribute__((packed)) {
 #define CONFIG_MAGIC            0xA5A5A5A5
 #define FIRMWARE_VALID_FLAG     0xAA
 
+// 固件包标志（firmware_info_t.reserved1）
+// 头部的firmware_size和firmware_crc32始终描述解压后的固件
+#define FIRMWARE_FLAG_COMPRESSED  0x01  // 头部之后为LZ压缩数据，接收时解压写入分区
+#define FIRMWARE_FLAG_DELTA       0x02  // 差分包：头部之后为firmware_delta_t，再之后为以基准固件为字典的LZ数据
+
+// 差分固件包扩展头 8字节（紧跟固件头，不写入分区）
+// 基准固件为当前运行分区中的固件，CRC32不匹配时在擦除目标分区之前拒绝
+typedef struct __attribute__((packed)) {
+    uint32_t base_crc32;      // 基准固件CRC32
+    uint32_t base_size;       // 基准固件大小（字节）
+} firmware_delta_t;
+
 // ==================== 系统配置结构体 ====================
 
 // 升级状态定义
@@ -67,7 +81,7 @@ typedef struct __attribute__((packed)) {
 #define UPGRADE_STATUS_SUCCESS       0x04  // 成功
 #define UPGRADE_STATUS_FAILED        0x05  // 失败
 
-// 系统配置结构体	60字节
+// 系统配置结构体	72字节
 typedef struct __attribute__((packed)) {
     uint32_t magic;              // 魔术字 0xA5A5A5A5
     uint8_t  active_bank;        // 当前激活分区 0=A区 1=B区
@@ -76,9 +90,27 @@ typedef struct __attribute__((packed)) {
     uint8_t  max_boot_retry;     // 最大启动重试次数（默认3）
     firmware_info_t bank_a_info; // A区固件信息
     firmware_info_t bank_b_info; // B区固件信息
+    uint8_t  node_id;            // 多机总线节点号 0=点对点（YMODEM_NODE_P2P）
+    uint8_t  reserved[3];
+    uint32_t bank_hw_crc[2];     // A/B区固件的硬件CRC单元原生校验值（见crc32_hw_start），0=未记录
     uint32_t config_crc32;       // 配置区CRC32校验
 } system_config_t;
 
+// ==================== 断点续传日志 ====================
+
+// 日志头 16字节（配置区第二页起始），每次下载开始时擦除该页写入一次
+// 之后为水位记录，每条4字节：已写入Flash的页数(uint16) + 页数反码(uint16)，
+// 只追加不擦除；掉电只写了一半的记录反码不匹配，读取时忽略
+typedef struct __attribute__((packed)) {
+    uint32_t magic;           // 魔术字 RESUME_MAGIC，下载完成后改写为0作废
+    uint32_t file_id;         // 文件标识（发送方计算的整个文件CRC32）
+    uint32_t file_size;       // 文件大小（字节）
+    uint32_t target_addr;     // 写入的分区地址
+} resume_journal_t;
+
+#define RESUME_MAGIC            0x52455355
+#define RESUME_MAX_RECORDS      ((FLASH_SECTOR_SIZE - sizeof(resume_journal_t)) / 4)
+
 // ==================== 日志相关定义 ====================
 
 // 升级日志条目（16字节）
@@ -0,0 +1,193 @@
+#include "lz_stream.h"
+
+// 解码状态
+#define LZ_STATE_TOKEN      0   // 等待令牌
+#define LZ_STATE_LIT_EXT    1   // 字面量长度扩展
+#define LZ_STATE_LITERAL    2   // 复制字面量
+#define LZ_STATE_OFFSET_LO  3   // 偏移低字节
+#define LZ_STATE_OFFSET_HI  4   // 偏移高字节
+#define LZ_STATE_MATCH_EXT  5   // 匹配长度扩展
+#define LZ_STATE_DONE       6   // 已完成
+#define LZ_STATE_ERROR      7   // 出错
+
+// 暂存区写入Flash
+static uint8_t lz_flush(lz_stream_t *s)
+{
+    if (s->stage_len == 0) {
+        return 1;
+    }
+    if (!s->write(s->flushed, s->stage, s->stage_len)) {
+        return 0;
+    }
+    s->flushed += s->stage_len;
+    s->stage_len = 0;
+    return 1;
+}
+
+// 输出一个字节，暂存区满则写入Flash
+static uint8_t lz_put(lz_stream_t *s, uint8_t byte)
+{
+    s->stage[s->stage_len++] = byte;
+    s->out_addr++;
+    if (s->stage_len == LZ_STAGE_SIZE) {
+        return lz_flush(s);
+    }
+    return 1;
+}
+
+// 读取当前输出位置之前第offset个字节：超出已输出范围的读字典，
+// 已写入Flash的直接读Flash，否则读暂存区
+static uint8_t lz_get(lz_stream_t *s, uint16_t offset)
+{
+    uint32_t produced = s->out_addr - s->out_start;
+    uint32_t addr;
+
+    if (offset > produced) {
+        return *(volatile uint8_t *)(s->dict_start + s->dict_len - (offset - produced));
+    }
+
+    addr = s->out_addr - offset;
+    if (addr < s->flushed) {
+        return *(volatile uint8_t *)addr;
+    }
+    return s->stage[addr - s->flushed];
+}
+
+// 复制匹配：源和目标可以重叠，需逐字节复制
+static uint8_t lz_copy_match(lz_stream_t *s)
+{
+    if (s->offset == 0 || s->offset > s->out_addr - s->out_start + s->dict_len ||
+        s->match_len > s->out_end - s->out_addr) {
+        return 0;
+    }
+
+    while (s->match_len > 0) {
+        if (!lz_put(s, lz_get(s, s->offset))) {
+            return 0;
+        }
+        s->match_len--;
+    }
+    return 1;
+}
+
+/**
+ * @brief  初始化流式解压
+ * @param  s: 解压状态
+ * @param  out_addr: 输出Flash起始地址（必须半字对齐）
+ * @param  out_size: 解压后大小
+ * @param  write: 输出写入函数
+ * @retval None
+ */
+void lz_stream_init(lz_stream_t *s, uint32_t out_addr, uint32_t out_size, lz_write_fn write)
+{
+    s->out_start = out_addr;
+    s->out_end = out_addr + out_size;
+    s->out_addr = out_addr;
+    s->flushed = out_addr;
+    s->dict_start = 0;
+    s->dict_len = 0;
+    s->lit_len = 0;
+    s->match_len = 0;
+    s->offset = 0;
+    s->stage_len = 0;
+    s->write = write;
+    s->state = (out_size == 0) ? LZ_STATE_DONE : LZ_STATE_TOKEN;
+}
+
+/**
+ * @brief  设置字典（差分升级的旧固件）
+ * @param  s: 解压状态
+ * @param  dict_addr: 字典Flash地址
+ * @param  dict_len: 字典长度
+ * @retval None
+ */
+void lz_stream_set_dict(lz_stream_t *s, uint32_t dict_addr, uint32_t dict_len)
+{
+    s->dict_start = dict_addr;
+    s->dict_len = dict_len;
+}
+
+/**
+ * @brief  输入一段压缩数据，解压结果写入Flash
+ * @param  s: 解压状态
+ * @param  data: 压缩数据
+ * @param  len: 数据长度
+ * @retval LZ_STREAM_OK/LZ_STREAM_DONE/LZ_STREAM_ERROR
+ */
+uint8_t lz_stream_feed(lz_stream_t *s, const uint8_t *data, uint32_t len)
+{
+    uint32_t i = 0;
+    uint8_t byte;
+
+    while (i < len && s->state < LZ_STATE_DONE) {
+        byte = data[i++];
+
+        switch (s->state) {
+        case LZ_STATE_TOKEN:
+            s->lit_len = byte >> 4;
+            s->match_len = (byte & 0x0F) + LZ_MIN_MATCH;
+            if (s->lit_len == 15) {
+                s->state = LZ_STATE_LIT_EXT;
+            } else if (s->lit_len > 0) {
+                s->state = LZ_STATE_LITERAL;
+            } else {
+                s->state = LZ_STATE_OFFSET_LO;
+            }
+            break;
+
+        case LZ_STATE_LIT_EXT:
+            s->lit_len += byte;
+            if (byte != 255) {
+                s->state = LZ_STATE_LITERAL;
+            }
+            break;
+
+        case LZ_STATE_LITERAL:
+            if (s->out_addr >= s->out_end || !lz_put(s, byte)) {
+                s->state = LZ_STATE_ERROR;
+                break;
+            }
+            if (--s->lit_len == 0) {
+                // 最后一个序列只有字面量
+                s->state = (s->out_addr == s->out_end) ? LZ_STATE_DONE : LZ_STATE_OFFSET_LO;
+            }
+            break;
+
+        case LZ_STATE_OFFSET_LO:
+            s->offset = byte;
+            s->state = LZ_STATE_OFFSET_HI;
+            break;
+
+        case LZ_STATE_OFFSET_HI:
+            s->offset |= (uint16_t)byte << 8;
+            if ((s->match_len - LZ_MIN_MATCH) == 15) {
+                s->state = LZ_STATE_MATCH_EXT;
+                break;
+            }
+            s->state = lz_copy_match(s) ? LZ_STATE_TOKEN : LZ_STATE_ERROR;
+            break;
+
+        case LZ_STATE_MATCH_EXT:
+            s->match_len += byte;
+            if (byte != 255) {
+                s->state = lz_copy_match(s) ? LZ_STATE_TOKEN : LZ_STATE_ERROR;
+            }
+            break;
+        }
+
+        // 匹配恰好结束在输出末尾
+        if (s->state == LZ_STATE_TOKEN && s->out_addr == s->out_end) {
+            s->state = LZ_STATE_DONE;
+        }
+    }
+
+    if (s->state == LZ_STATE_DONE) {
+        if (!lz_flush(s)) {
+            s->state = LZ_STATE_ERROR;
+        } else {
+            return LZ_STREAM_DONE;
+        }
+    }
+
+    return (s->state == LZ_STATE_ERROR) ? LZ_STREAM_ERROR : LZ_STREAM_OK;
+}
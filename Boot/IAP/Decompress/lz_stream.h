@@ -0,0 +1,78 @@
+#ifndef __LZ_STREAM_H
+#define __LZ_STREAM_H
+
+#include "stdint.h"
+
+/*
+ * 压缩格式（与LZ4块格式相同）：由若干序列组成，每个序列为
+ *   令牌(1B) + [字面量长度扩展] + 字面量 + 偏移(2B小端) + [匹配长度扩展]
+ * 令牌高4位为字面量长度，低4位为匹配长度-4，值为15时后跟扩展字节（逐字节累加，直到不为255）。
+ * 最后一个序列只有字面量，输出达到解压后大小即结束。
+ *
+ * 匹配引用直接读取已写入Flash的输出，不需要RAM滑动窗口，
+ * 只在RAM中暂存尚未写入Flash的一小段输出。
+ *
+ * 差分升级时以旧固件作为字典：字典视为紧接在输出之前的数据，
+ * 偏移超过已输出长度的匹配从字典中读取。
+ */
+
+#define LZ_STAGE_SIZE       256     // 暂存区大小，必须为偶数（按半字写Flash）
+#define LZ_MIN_MATCH        4       // 最短匹配长度
+
+// lz_stream_feed返回值
+#define LZ_STREAM_OK        0       // 需要更多数据
+#define LZ_STREAM_DONE      1       // 解压完成，输出已全部写入Flash
+#define LZ_STREAM_ERROR     2       // 数据错误或写Flash失败
+
+/**
+ * @brief  输出写入函数：把len字节写入Flash地址addr
+ * @retval 1=成功 0=失败
+ */
+typedef uint8_t (*lz_write_fn)(uint32_t addr, uint8_t *buf, uint32_t len);
+
+typedef struct {
+    uint32_t out_start;             // 输出起始地址
+    uint32_t out_end;               // 输出结束地址
+    uint32_t out_addr;              // 下一个输出字节的地址
+    uint32_t flushed;               // 已写入Flash的结束地址（之前的输出可直接从Flash读取）
+    uint32_t dict_start;            // 字典起始地址
+    uint32_t dict_len;              // 字典长度，0=无字典
+    uint32_t lit_len;               // 当前序列剩余字面量长度
+    uint32_t match_len;             // 当前序列匹配长度
+    uint16_t offset;                // 当前序列匹配偏移
+    uint16_t stage_len;             // 暂存区已有字节数
+    uint8_t  state;                 // 解码状态
+    lz_write_fn write;              // 输出写入函数
+    uint8_t  stage[LZ_STAGE_SIZE];  // 尚未写入Flash的输出
+} lz_stream_t;
+
+/**
+ * @brief  初始化流式解压
+ * @param  s: 解压状态
+ * @param  out_addr: 输出Flash起始地址（必须半字对齐）
+ * @param  out_size: 解压后大小
+ * @param  write: 输出写入函数
+ * @retval None
+ */
+void lz_stream_init(lz_stream_t *s, uint32_t out_addr, uint32_t out_size, lz_write_fn write);
+
+/**
+ * @brief  设置字典（差分升级的旧固件），须在lz_stream_init之后、输入数据之前调用
+ * @param  s: 解压状态
+ * @param  dict_addr: 字典Flash地址
+ * @param  dict_len: 字典长度
+ * @retval None
+ */
+void lz_stream_set_dict(lz_stream_t *s, uint32_t dict_addr, uint32_t dict_len);
+
+/**
+ * @brief  输入一段压缩数据，解压结果写入Flash
+ * @param  s: 解压状态
+ * @param  data: 压缩数据
+ * @param  len: 数据长度
+ * @retval LZ_STREAM_OK/LZ_STREAM_DONE/LZ_STREAM_ERROR
+ * @note   解压完成后多余的输入（如Ymodem末包填充）被忽略
+ */
+uint8_t lz_stream_feed(lz_stream_t *s, const uint8_t *data, uint32_t len);
+
+#endif // __LZ_STREAM_H
@@ -3,6 +3,30 @@
 
 #include "stdint.h"
 
+// CRC32查表方式选择（结果相同，速度对比见tools/crc_benchmark.py）：
+// 1=256项字节表(1KB Flash)，逐字节查表，用于Flash空间紧张的配置
+// 4=4张表(4KB Flash)，按字读取，每4字节查4次表
+// 8=8张表(8KB Flash)，每次处理8字节，Bootloader区只有16KB，须确认代码仍放得下
+#ifndef CRC32_SLICE_BY
+#define CRC32_SLICE_BY  4
+#endif
+
+// Flash区域校验使用硬件CRC单元：1=启用（按字计算，结果与软件查表相同） 0=只用软件查表
+// 主机编译（如tools/crc_benchmark.py）时须定义为0
+#ifndef CRC32_USE_HW
+#define CRC32_USE_HW    1
+#endif
+
+// 硬件CRC单元的DMA输入通道（存储器到存储器模式，任意空闲通道均可；USART1占用通道4、5）
+#define CRC32_DMA_CLK           RCC_AHBPeriph_DMA1
+#define CRC32_DMA_CHANNEL       DMA1_Channel1
+#define CRC32_DMA_FLAG_TC       DMA1_FLAG_TC1
+
+// 流式计算上下文：数据可分段输入，结果与一次性计算相同
+typedef struct {
+    uint32_t crc;   // 中间值（未取反）
+} crc32_ctx_t;
+
 /**
  * @brief  计算数据的CRC32校验值
  * @param  data: 数据指针
@@ -16,7 +40,92 @@ uint32_t crc32_calculate(const uint8_t *data, uint32_t length);
  * @param  addr: Flash起始地址
  * @param  length: 数据长度
  * @retval CRC32校验值
+ * @note   CRC32_USE_HW为1且地址4字节对齐时使用硬件CRC单元
  */
 uint32_t crc32_calculate_flash(uint32_t addr, uint32_t length);
 
+/**
+ * @brief  开始流式计算CRC32
+ * @param  ctx: 计算上下文
+ * @retval None
+ */
+void crc32_init(crc32_ctx_t *ctx);
+
+/**
+ * @brief  输入一段数据
+ * @param  ctx: 计算上下文
+ * @param  data: 数据指针（RAM或Flash地址均可）
+ * @param  length: 数据长度
+ * @retval None
+ */
+void crc32_update(crc32_ctx_t *ctx, const uint8_t *data, uint32_t length);
+
+/**
+ * @brief  结束流式计算
+ * @param  ctx: 计算上下文
+ * @retval 已输入全部数据的CRC32校验值
+ */
+uint32_t crc32_final(const crc32_ctx_t *ctx);
+
+#if CRC32_USE_HW
+/**
+ * @brief  开始用软件计算硬件原生CRC（CRC-32/MPEG-2，按字输入）
+ * @param  ctx: 计算上下文
+ * @retval None
+ * @note   与crc32_update共用查找表，速度相同；用于接收固件时随数据累计，
+ *         不必写入后再用DMA读一遍整个分区
+ */
+void crc32_native_init(crc32_ctx_t *ctx);
+
+/**
+ * @brief  按字输入一段数据
+ * @param  ctx: 计算上下文
+ * @param  data: 数据指针（RAM或Flash地址均可，不要求对齐）
+ * @param  words: 字数
+ * @retval None
+ */
+void crc32_native_update(crc32_ctx_t *ctx, const uint8_t *data, uint32_t words);
+
+/**
+ * @brief  结束计算
+ * @param  ctx: 计算上下文
+ * @retval 硬件原生CRC值
+ */
+uint32_t crc32_native_final(const crc32_ctx_t *ctx);
+
+/**
+ * @brief  读取一次Flash区域，同时计算CRC32和硬件原生CRC
+ * @param  addr: Flash起始地址
+ * @param  length: 数据长度
+ * @param  native: 硬件原生CRC（输出）
+ * @retval CRC32校验值
+ * @note   与crc32_calculate_flash一样，DMA正在使用CRC单元时改用软件查表
+ */
+uint32_t crc32_calculate_flash_native(uint32_t addr, uint32_t length, uint32_t *native);
+
+/**
+ * @brief  启动DMA把Flash区域逐字送入硬件CRC单元，立即返回
+ * @param  addr: Flash起始地址（4字节对齐）
+ * @param  length: 数据长度，不是4的整数倍时最后一个字包含其后的字节
+ * @retval None
+ * @note   结果为硬件原生的CRC-32/MPEG-2（字不反转、结果不取反），与标准CRC32不同，
+ *         只能与之前用同样方式算出的值比较。计算期间crc32_calculate_flash改用软件查表
+ */
+void crc32_hw_start(uint32_t addr, uint32_t length);
+
+/**
+ * @brief  查询DMA计算是否仍在进行
+ * @param  None
+ * @retval 1=进行中 0=已完成
+ */
+uint8_t crc32_hw_busy(void);
+
+/**
+ * @brief  读取计算结果（crc32_hw_busy返回0之后调用）
+ * @param  None
+ * @retval 硬件原生CRC值
+ */
+uint32_t crc32_hw_result(void);
+#endif
+
 #endif // __CRC32_H
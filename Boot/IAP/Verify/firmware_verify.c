@@ -4,6 +4,42 @@
 #include "bootloader.h"
 #include "string.h"
 
+// 外部配置变量声明（启动时init_system_config已读取并校验，这里不再读Flash）
+extern system_config_t g_config;
+
+// 各分区的校验状态：每次复位后每个分区最多计算一次CRC，之后直接返回缓存的结果
+#define VERIFY_UNKNOWN  0   // 本次复位后尚未校验
+#define VERIFY_BUSY     1   // DMA正在计算
+#define VERIFY_VALID    2   // 固件有效
+#define VERIFY_INVALID  3   // 固件无效
+
+static uint8_t verify_state[2] = {VERIFY_UNKNOWN, VERIFY_UNKNOWN};
+static uint8_t verify_bank;         // 最近请求校验的分区（firmware_verify_poll返回它的结果）
+#if CRC32_USE_HW
+#define VERIFY_NONE     0xFF
+static uint8_t busy_bank = VERIFY_NONE; // DMA正在校验的分区，与verify_bank不一定相同
+static uint32_t verify_expected;    // 硬件CRC原生校验期望值
+#endif
+
+/**
+ * @brief  收取DMA校验的结果（写回正在校验的那个分区）
+ * @param  None
+ * @retval 1=DMA仍在计算 0=空闲
+ */
+static uint8_t firmware_verify_collect(void)
+{
+#if CRC32_USE_HW
+    if (busy_bank != VERIFY_NONE) {
+        if (crc32_hw_busy()) {
+            return 1;
+        }
+        verify_state[busy_bank] = (crc32_hw_result() == verify_expected) ? VERIFY_VALID : VERIFY_INVALID;
+        busy_bank = VERIFY_NONE;
+    }
+#endif
+    return 0;
+}
+
 /**
  * @brief  验证指定分区的固件完整性
  * @param  bank: 分区号 0=A区 1=B区
@@ -11,59 +47,117 @@
  */
 uint8_t firmware_verify(uint8_t bank)
 {
-    system_config_t config;
+    bank = bank ? 1 : 0;
+
+    firmware_verify_start(bank);
+    while (firmware_verify_poll() == FIRMWARE_VERIFY_BUSY) {
+    }
+
+    return verify_state[bank] == VERIFY_VALID;
+}
+
+/**
+ * @brief  作废分区的校验结果（分区内容将被改写时调用）
+ * @param  bank: 分区号 0=A区 1=B区
+ * @retval None
+ */
+void firmware_verify_invalidate(uint8_t bank)
+{
+    bank = bank ? 1 : 0;
+
+    // 有校验在进行时等待DMA结束，避免结果在作废之后写回
+    while (firmware_verify_collect()) {
+    }
+    verify_state[bank] = VERIFY_UNKNOWN;
+}
+
+/**
+ * @brief  启动指定分区的固件校验
+ * @param  bank: 分区号 0=A区 1=B区
+ * @retval None
+ */
+void firmware_verify_start(uint8_t bank)
+{
     firmware_info_t *fw_info;
     uint32_t app_addr;
-    uint32_t calculated_crc;
 
-    // 读取配置
-    if (!config_read(&config)) {
-        return 0;  // 配置无效
+    bank = bank ? 1 : 0;
+
+    // 本次复位后已校验过（或正在校验）：只切换查询的分区，另一分区在进行的DMA校验照常由busy_bank收取
+    if (verify_state[bank] != VERIFY_UNKNOWN) {
+        verify_bank = bank;
+        return;
     }
 
+    // DMA和CRC单元同一时间只能校验一个分区
+    while (firmware_verify_collect()) {
+    }
+
+    verify_bank = bank;
+    verify_state[bank] = VERIFY_INVALID;
+
     // 确定分区地址和信息
     if (bank == 0) {
-        fw_info = &config.bank_a_info;
+        fw_info = &g_config.bank_a_info;
         app_addr = APP_A_SECTOR_ADDR;
     } else {
-        fw_info = &config.bank_b_info;
+        fw_info = &g_config.bank_b_info;
         app_addr = APP_B_SECTOR_ADDR;
     }
 
     // 检查魔术字
     if (fw_info->magic != FIRMWARE_MAGIC) {
-        return 0;
+        return;
     }
 
     // 检查有效标志
     if (fw_info->is_valid != FIRMWARE_VALID_FLAG) {
-        return 0;
+        return;
     }
 
     // 检查固件大小
     if (fw_info->firmware_size == 0 ||
         fw_info->firmware_size > APP_BANK_SIZE) {
-        return 0;
+        return;
     }
 
-    // 计算固件CRC32（跳过头部24字节，只计算实际固件）
-    // 注意：firmware_size字段存储的就是固件数据的大小（不包含24字节头）
-    calculated_crc = crc32_calculate_flash(app_addr + 24,
-                                          fw_info->firmware_size);
-
+    // 检查栈指针有效性（固件头部后面就是实际APP代码），先于CRC检查，无效时不必计算
+    uint32_t stack_ptr = *(__IO uint32_t*)(app_addr + 24);
+    if ((stack_ptr & 0x2FFF0000) != 0x20000000) {
+        return;  // 栈指针无效
+    }
 
-    // 比对CRC32
-    if (calculated_crc != fw_info->firmware_crc32) {
-        return 0;  // CRC校验失败
+#if CRC32_USE_HW
+    // 升级时记录过硬件原生校验值：DMA把固件送入CRC单元，CPU不参与，结果由firmware_verify_poll比对
+    if (g_config.bank_hw_crc[bank] != 0) {
+        verify_expected = g_config.bank_hw_crc[bank];
+        verify_state[bank] = VERIFY_BUSY;
+        busy_bank = bank;
+        crc32_hw_start(app_addr + 24, fw_info->firmware_size);
+        return;
     }
+#endif
 
-    // 检查栈指针有效性（固件头部后面就是实际APP代码）
-    uint32_t stack_ptr = *(__IO uint32_t*)(app_addr + 24);
-    if ((stack_ptr & 0x2FFF0000) != 0x20000000) {
-        return 0;  // 栈指针无效
+    // 计算固件CRC32（跳过头部24字节，只计算实际固件）
+    // 注意：firmware_size字段存储的就是固件数据的大小（不包含24字节头）
+    // 启用CRC32_USE_HW时由硬件CRC单元按字计算，结果与打包工具的binascii.crc32相同
+    if (crc32_calculate_flash(app_addr + 24, fw_info->firmware_size) == fw_info->firmware_crc32) {
+        verify_state[bank] = VERIFY_VALID;
     }
+}
 
-    return 1;  // 固件有效
+/**
+ * @brief  查询firmware_verify_start启动的校验结果
+ * @param  None
+ * @retval FIRMWARE_VERIFY_BUSY=进行中 1=固件有效 0=固件无效
+ */
+uint8_t firmware_verify_poll(void)
+{
+    firmware_verify_collect();
+    if (verify_state[verify_bank] == VERIFY_BUSY) {
+        return FIRMWARE_VERIFY_BUSY;
+    }
+    return verify_state[verify_bank] == VERIFY_VALID;
 }
 
 /**
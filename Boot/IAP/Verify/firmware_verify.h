@@ -2,14 +2,45 @@
 #define __FIRMWARE_VERIFY_H
 
 #include "iap_config.h"
+#include "crc32.h"
+
+// firmware_verify_poll返回值：校验仍在进行
+#define FIRMWARE_VERIFY_BUSY    0xFF
 
 /**
  * @brief  验证指定分区的固件完整性
  * @param  bank: 分区号 0=A区 1=B区
  * @retval 1=固件有效 0=固件无效
+ * @note   使用init_system_config读入的g_config，不再读配置区。每次复位后每个分区只计算一次CRC，
+ *         之后返回缓存的结果；已用firmware_verify_start启动的校验直接等待其结果
  */
 uint8_t firmware_verify(uint8_t bank);
 
+/**
+ * @brief  作废分区的校验结果（分区内容将被改写时调用）
+ * @param  bank: 分区号 0=A区 1=B区
+ * @retval None
+ */
+void firmware_verify_invalidate(uint8_t bank);
+
+/**
+ * @brief  启动指定分区的固件校验，不等待CRC计算完成
+ * @param  bank: 分区号 0=A区 1=B区
+ * @retval None
+ * @note   配置中记录了硬件CRC原生校验值时由DMA把固件送入硬件CRC单元，CPU可继续其他初始化，
+ *         之后用firmware_verify_poll取结果；未记录时按标准CRC32同步计算。
+ *         上一次校验未完成时先等待其完成；该分区已有缓存结果时不再计算
+ */
+void firmware_verify_start(uint8_t bank);
+
+/**
+ * @brief  查询firmware_verify_start启动的校验结果
+ * @param  None
+ * @retval FIRMWARE_VERIFY_BUSY=进行中 1=固件有效 0=固件无效
+ * @note   结果同时缓存到该分区，之后的firmware_verify直接返回
+ */
+uint8_t firmware_verify_poll(void);
+
 /**
  * @brief  解析固件头部信息
  * @param  addr: 固件Flash地址
@@ -0,0 +1,21 @@
+#ifndef __CRC16_H
+#define __CRC16_H
+
+#include "stdint.h"
+
+// CRC16查表方式选择：0=256项字节表(512字节Flash，速度最快) 1=16项半字节表(32字节Flash)
+#ifndef CRC16_USE_NIBBLE_TABLE
+#define CRC16_USE_NIBBLE_TABLE  0
+#endif
+
+/**
+ * @brief  计算CRC16-XMODEM校验值（多项式0x1021，初值0）
+ * @param  crc: 上一段数据的CRC16结果，首段传0
+ * @param  data: 数据指针
+ * @param  length: 数据长度
+ * @retval CRC16校验值
+ * @note   可分段连续调用，结果与一次计算全部数据相同
+ */
+uint16_t crc16_update(uint16_t crc, const uint8_t *data, uint32_t length);
+
+#endif // __CRC16_H
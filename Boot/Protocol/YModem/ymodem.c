@@ -2,15 +2,88 @@
 #include "bootloader.h"
 #include "bsp_led.h"
 #include "sysTick.h"
+#include "crc16.h"
+#include "lz_stream.h"
+#include "crc32.h"
+#include "config_manager.h"
 
 // 全局变量定义
-seq_queue_t rx_queue;
-download_buf_t recvBuf;
+ymodem_pkt_pool_t pkt_pool;
 
 // YMODEM状态和地址管理
-uint8_t ymodem_status = 0;		  // YMODEM接收状态
-static uint32_t ymodem_addr = 0;  // 当前写入Flash的地址
-uint16_t ymodem_packet_count = 0; // ==== 新增：数据包计数 ====
+volatile uint8_t ymodem_status = 0; // YMODEM接收状态
+static uint32_t ymodem_addr = 0;	// 当前写入Flash的地址
+uint16_t ymodem_packet_count = 0;	// ==== 新增：数据包计数 ====
+
+// 组帧状态（仅在接收中断中访问）
+static uint16_t frame_expect = 0;		   // 当前帧期望长度（0=等待帧头）
+static uint16_t frame_len = 0;			   // 当前帧已接收长度
+static download_buf_t *frame_buf = NULL; // 当前帧写入的缓冲池槽位（NULL=缓冲池满，丢弃该帧）
+static uint8_t frame_head = 0;			   // 当前帧帧头
+static uint8_t frame_seq = 0;			   // 当前帧序号
+static uint8_t frame_offset = 0;		   // 当前帧在接收窗口内的偏移
+static volatile uint8_t ymodem_ack_pending = 0; // 数据包已入池但空闲槽位不足，待释放槽位后再应答
+static volatile uint8_t ymodem_abort = 0;		// 传输已取消，等待主循环重新握手
+static uint8_t ymodem_stream = 0;				// 本次传输为YMODEM-G流式模式
+
+// 滑动窗口状态（窗口大小由主循环在起始帧中设置，其余仅在接收中断中访问）
+static volatile uint8_t ymodem_window = 0; // 协商的窗口大小，0=标准停等模式
+static uint8_t rx_expect_seq = 0;		   // 期望的下一个数据包序号（窗口模式下即窗口前沿）
+static uint8_t rx_present = 0;			   // 窗口内乱序收到的数据包位图，bit k对应序号rx_expect_seq+k
+static uint8_t rx_nak_sent = 0;			   // 已为窗口前沿的缺失包发送过NAK
+static volatile uint16_t ymodem_block = 0; // 协商的大数据块大小，0=未协商（不接受BLK帧）
+
+// 波特率协商状态（仅主循环访问）
+static const uint32_t ymodem_baud_table[] = {2000000, 921600, 460800}; // 可切换档位，从高到低
+static uint32_t ymodem_baudrate = DEBUG_USART_BAUDRATE; // 当前波特率
+static uint16_t ymodem_baud_wait = 0;					// 等待测试帧的剩余时间(ms)，0=未在切换
+
+// 即时擦除：只擦除文件覆盖的页，写指针将跨入下一页前才擦除该页。
+// 擦除期间CPU取指暂停，串口只能靠DMA缓冲，因此只在发送方停下等待应答时擦除
+static volatile uint32_t ymodem_erase_addr = 0; // 已擦除区域的结束地址（下一个待擦除页）
+static uint32_t ymodem_erase_end = 0;			// 文件覆盖范围的擦除结束地址
+static uint32_t rx_write_addr = 0;				// 已入池数据写入Flash后的结束地址（中断中维护）
+static uint8_t rx_granted = 0;					// 窗口模式：最近一次应答允许发送方发送到的序号
+static uint32_t ymodem_bank_end = 0;			// 目标分区结束地址
+
+// 固件包格式：首个数据包带固件头，由主循环解析后才能确定写入方式和擦除范围
+static volatile uint8_t ymodem_header_pending = 0; // 首个数据包尚未处理，暂缓应答
+static volatile uint8_t ymodem_compressed = 0;	   // 压缩或差分固件包：头部之后的数据解压后写入
+static lz_stream_t ymodem_lz;					   // 流式解压状态
+static uint32_t ymodem_lz_ratio = 1;			   // 每字节压缩数据预计擦除的输出字节数
+
+// 断点续传：发送方在起始帧带文件标识时，原始固件包按页记录写入水位，
+// 复位或断线后同一文件从水位处继续
+static uint8_t ymodem_resume_req = 0; // 发送方请求续传
+static uint32_t ymodem_resume_id = 0; // 文件标识
+static uint8_t ymodem_journal = 0;	  // 本次下载正在记录水位
+
+// 差异页传输：只传输内容变化的页，其余页保留或从运行分区复制
+static uint8_t ymodem_pages = 0;									// 协商的文件页数，0=未协商
+static uint8_t ymodem_sparse = 0;									// 已执行页计划，数据包按页计划定位
+static uint32_t ymodem_sparse_left = 0;								// 页计划中尚未写入的SEND页字节数
+static uint8_t ymodem_page_map[APP_BANK_SIZE / FLASH_SECTOR_SIZE]; // 每页处理方式
+
+// 多机总线寻址状态
+#define NODE_IDLE      0 // 未被选中：只处理SELECT和POLL，不发送任何数据
+#define NODE_SELECTED  1 // 被选中：标准会话
+#define NODE_BROADCAST 2 // 广播会话：接收但不应答
+static uint8_t ymodem_node_id = YMODEM_NODE_P2P;			  // 本节点号
+static volatile uint8_t ymodem_node_state = NODE_SELECTED;	  // 寻址状态
+static uint8_t ymodem_polled = 0;							  // 正在应答POLL（未被选中也允许发送）
+static uint8_t ymodem_reported = 0;							  // 已应答过POLL（上报校验结果用）
+static volatile uint8_t ymodem_bcast = 0;					  // 本次传输为广播会话
+static uint32_t ymodem_bcast_map = 0;						  // 广播会话已写入的数据包位图
+static volatile uint8_t ymodem_bcast_packets = 0;			  // 广播会话文件的数据包数
+
+// 流式校验：写入Flash的数据按地址顺序累计CRC32（不含固件头），接收完成即得到校验结果，
+// 不必再读一遍整个分区。写入位置出现空洞（广播会话乱序写入）时放弃，由调用方重新计算
+static crc32_ctx_t ymodem_crc;	   // 累计中的CRC32
+static uint32_t ymodem_crc_addr = 0; // 已累计到的地址，0=放弃流式校验
+#if CRC32_USE_HW
+static crc32_ctx_t ymodem_hw_crc;		// 累计中的硬件原生CRC（只含整字）
+static uint32_t ymodem_hw_crc_addr = 0; // 原生CRC已累计到的地址（从固件数据起按字对齐）
+#endif
 
 // ==== 新增：目标地址和结果管理 ====
 uint32_t g_ymodem_target_addr = APP_SECTOR_ADDR; // 默认写入地址（可被修改）
@@ -18,205 +91,1578 @@ volatile uint8_t g_ymodem_success = 0;			 // 接收成功标志
 uint32_t g_ymodem_byte_count = 0;				 // 接收字节计数
 uint32_t g_ymodem_file_size = 0;				 // ==== 新增：文件总大小 ====
 
-// 初始化队列
-void queue_initiate(seq_queue_t *Q)
+// 发送数据：多机总线上未被选中或处于广播会话的节点保持静默，只在被查询时应答
+static void ymodem_send(uint8_t *buf, uint8_t len)
 {
-	Q->rear = 0;  // 队尾指针
-	Q->front = 0; // 队头指针
-	Q->count = 0; // 计数器
+	if (ymodem_node_state == NODE_SELECTED || ymodem_polled)
+	{
+		Usart_Send_Data(buf, len);
+	}
 }
 
-// 判断队列是否非空
-int queue_not_empty(seq_queue_t *Q)
+// YMODEM协议响应函数
+void ymodem_ack(void)
 {
-	if (Q->count != 0)
-		return 1;
+	uint8_t buf = YMODEM_ACK;
+	ymodem_send(&buf, 1);
+}
+
+void ymodem_nack(void)
+{
+	uint8_t buf = YMODEM_NAK;
+	ymodem_send(&buf, 1);
+}
+
+void ymodem_c(void)
+{
+	uint8_t buf = YMODEM_C;
+	ymodem_send(&buf, 1);
+	// 移除printf提示
+}
+
+void ymodem_end(void)
+{
+	uint8_t buf = YMODEM_END;
+	ymodem_send(&buf, 1);
+}
+
+void ymodem_cancel(void)
+{
+	uint8_t buf[2] = {YMODEM_CA, YMODEM_CA};
+	ymodem_send(buf, 2);
+}
+
+void ymodem_g(void)
+{
+	uint8_t buf = YMODEM_G;
+	ymodem_send(&buf, 1);
+}
+
+// 发送当前模式的握手字符
+static void ymodem_handshake(void)
+{
+	if (ymodem_stream)
+	{
+		ymodem_g();
+	}
 	else
+	{
+		ymodem_c();
+	}
+}
+
+// 取消本次传输，由主循环重新握手（中断和主循环均可调用）
+static void ymodem_abort_transfer(void)
+{
+	ymodem_cancel();
+	ymodem_abort = 1;
+}
+
+// 带序号的应答（窗口模式）：ACK为累计应答，NAK请求重发指定序号
+static void ymodem_ack_seq(uint8_t seq)
+{
+	uint8_t buf[2] = {YMODEM_ACK, seq};
+	ymodem_send(buf, 2);
+}
+
+static void ymodem_nack_seq(uint8_t seq)
+{
+	uint8_t buf[2] = {YMODEM_NAK, seq};
+	ymodem_send(buf, 2);
+}
+
+// 是否为数据帧帧头
+static uint8_t ymodem_is_data(uint8_t head)
+{
+	return head == YMODEM_SOH || head == YMODEM_STX || head == YMODEM_BLK;
+}
+
+// 校验数据帧和扩展命令帧的CRC16，控制帧（EOT/CA）无需校验
+static uint8_t ymodem_frame_check(const download_buf_t *p)
+{
+	uint16_t size;
+	uint16_t crc;
+
+	if (p->data[0] == YMODEM_EXT)
+	{
+		size = p->len - YMODEM_EXT_OVERHEAD;
+		crc = ((uint16_t)p->data[4 + size] << 8) | p->data[5 + size];
+		return crc16_update(0, &p->data[1], 3 + size) == crc;
+	}
+
+	if (!ymodem_is_data(p->data[0]))
+	{
+		return 1;
+	}
+
+	size = p->len - YMODEM_FRAME_OVERHEAD;
+	crc = ((uint16_t)p->data[3 + size] << 8) | p->data[4 + size];
+
+	// 序号与序号反码必须匹配，CRC16不覆盖这两个字节
+	if ((uint8_t)(p->data[1] ^ p->data[2]) != 0xFF)
+	{
 		return 0;
+	}
+
+	return crc16_update(0, &p->data[3], size) == crc;
+}
+
+/**
+ * @brief  发送扩展命令帧
+ * @param  cmd: 命令字
+ * @param  data: 数据
+ * @param  len: 数据长度
+ * @retval None
+ */
+static void ymodem_send_ext(uint8_t cmd, const uint8_t *data, uint16_t len)
+{
+	uint8_t head[4];
+	uint8_t tail[2];
+	uint16_t crc;
+	uint16_t chunk;
+
+	head[0] = YMODEM_EXT;
+	head[1] = cmd;
+	head[2] = len & 0xFF;
+	head[3] = len >> 8;
+	crc = crc16_update(0, &head[1], 3);
+	crc = crc16_update(crc, data, len);
+	tail[0] = crc >> 8;
+	tail[1] = crc & 0xFF;
+
+	ymodem_send(head, 4);
+	while (len > 0)
+	{
+		chunk = (len > 255) ? 255 : len;
+		ymodem_send((uint8_t *)data, chunk);
+		data += chunk;
+		len -= chunk;
+	}
+	ymodem_send(tail, 2);
+}
+
+/**
+ * @brief  在起始帧选项区查找"key=value"选项
+ * @param  opts: 选项区起始（空格分隔，以\0结束）
+ * @param  end: 选项区结束位置
+ * @param  key: 选项名
+ * @param  value: 解析出的十进制数值（输出）
+ * @retval 1=找到 0=未找到
+ */
+static uint8_t ymodem_get_option(const uint8_t *opts, const uint8_t *end, const char *key,
+								 uint32_t *value)
+{
+	const uint8_t *p = opts;
+	const char *k;
+
+	while (p < end && *p != 0)
+	{
+		// 比较选项名
+		k = key;
+		while (p < end && *k != 0 && *p == (uint8_t)*k)
+		{
+			p++;
+			k++;
+		}
+
+		if (*k == 0 && p < end && *p == '=')
+		{
+			p++;
+			*value = 0;
+			while (p < end && *p >= '0' && *p <= '9')
+			{
+				*value = *value * 10 + (*p - '0');
+				p++;
+			}
+			return 1;
+		}
+
+		// 跳到下一个选项
+		while (p < end && *p != 0 && *p != ' ')
+		{
+			p++;
+		}
+		while (p < end && *p == ' ')
+		{
+			p++;
+		}
+	}
+	return 0;
+}
+
+// 向选项应答文本追加"key=value"
+static uint16_t ymodem_put_option(uint8_t *buf, uint16_t len, const char *key, uint32_t value)
+{
+	uint8_t digits[10];
+	uint8_t n = 0;
+
+	if (len > 0)
+	{
+		buf[len++] = ' ';
+	}
+	while (*key != 0)
+	{
+		buf[len++] = (uint8_t)*key++;
+	}
+	buf[len++] = '=';
+
+	do
+	{
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	} while (value != 0);
+	while (n > 0)
+	{
+		buf[len++] = digits[--n];
+	}
+	return len;
+}
+// 波特率测试帧第i字节：0x55/0xFF交替打底，覆盖各种位翻转
+static uint8_t ymodem_baud_pattern(uint8_t i)
+{
+	return (uint8_t)(i * 73) ^ ((i & 1) ? 0xFF : 0x55);
+}
+
+// 选出不超过发送方上限的最高可用波特率
+static uint32_t ymodem_baud_select(uint32_t max)
+{
+	uint8_t i;
+
+	for (i = 0; i < sizeof(ymodem_baud_table) / sizeof(ymodem_baud_table[0]); i++)
+	{
+		if (ymodem_baud_table[i] <= max && ymodem_baud_table[i] <= DEBUG_USART_BAUDRATE_MAX)
+		{
+			return ymodem_baud_table[i];
+		}
+	}
+	return DEBUG_USART_BAUDRATE;
+}
+
+// 切换串口波特率（等待已发送数据发完）
+static void ymodem_set_baudrate(uint32_t baudrate)
+{
+	if (baudrate != ymodem_baudrate)
+	{
+		Usart_Set_BaudRate(baudrate);
+		ymodem_baudrate = baudrate;
+	}
+}
+
+/**
+ * @brief  处理波特率切换后的测试帧
+ * @param  p: 数据包
+ * @retval None
+ * @note   测试图案完整无误则原样回送并发握手字符开始数据传输，否则继续等待直到超时
+ */
+static void ymodem_baud_test(const download_buf_t *p)
+{
+	uint8_t i;
+
+	if (p->data[0] != YMODEM_EXT || p->data[1] != YMODEM_EXT_PING ||
+		p->len != YMODEM_EXT_OVERHEAD + YMODEM_BAUD_TEST_LEN)
+	{
+		return;
+	}
+
+	for (i = 0; i < YMODEM_BAUD_TEST_LEN; i++)
+	{
+		if (p->data[4 + i] != ymodem_baud_pattern(i))
+		{
+			return;
+		}
+	}
+
+	ymodem_baud_wait = 0;
+	ymodem_send_ext(YMODEM_EXT_PING, &p->data[4], YMODEM_BAUD_TEST_LEN);
+	ymodem_handshake();
+}
+
+// 擦除到end所在页为止（不超过文件覆盖范围），已擦除的页不重复擦除
+static uint8_t ymodem_erase_ahead(uint32_t end)
+{
+	while (ymodem_erase_addr < end && ymodem_erase_addr < ymodem_erase_end)
+	{
+		if (!mcu_flash_erase(ymodem_erase_addr, 1))
+		{
+			return 0;
+		}
+		ymodem_erase_addr += FLASH_SECTOR_SIZE;
+	}
+	return 1;
+}
+
+// 按地址顺序累计CRC32：固件头之前的部分跳过，只接受紧接在已累计范围之后的数据
+static void ymodem_crc_feed(uint32_t addr, const uint8_t *buf, uint32_t len)
+{
+	uint32_t start = g_ymodem_target_addr + sizeof(firmware_info_t);
+
+	if (ymodem_crc_addr == 0)
+	{
+		return;
+	}
+	if (addr < start)
+	{
+		if (addr + len <= start)
+		{
+			return;
+		}
+		buf += start - addr;
+		len -= start - addr;
+		addr = start;
+	}
+
+	if (addr != ymodem_crc_addr)
+	{
+		ymodem_crc_addr = 0;
+		return;
+	}
+	crc32_update(&ymodem_crc, buf, len);
+	ymodem_crc_addr += len;
+
+#if CRC32_USE_HW
+	// 硬件原生CRC按整字累计，取刚回读比对过的Flash内容，不足一个字的部分等下一段凑齐
+	len = (ymodem_crc_addr - ymodem_hw_crc_addr) / 4;
+	crc32_native_update(&ymodem_hw_crc, (const uint8_t *)ymodem_hw_crc_addr, len);
+	ymodem_hw_crc_addr += len * 4;
+#endif
 }
 
-// 入队列
-int queue_append(seq_queue_t *Q, uint8_t x)
+// 写入Flash：写入前按需擦除目标页，写入后回读比对，并用RAM中的数据累计CRC32
+// （也作为解压输出的写入函数）
+static uint8_t ymodem_flash_write(uint32_t addr, uint8_t *buf, uint32_t len)
 {
-	if (Q->count > 0 && Q->rear == Q->front)
+	if (!ymodem_erase_ahead(addr + len) || !mcu_flash_write(addr, buf, len) ||
+		memcmp((const void *)addr, buf, len) != 0)
 	{
-		// 队列已满，直接返回失败
 		return 0;
 	}
-	else
+	ymodem_crc_feed(addr, buf, len);
+	return 1;
+}
+
+// 应答后发送方最多还能发送的数据写入Flash后的结束地址
+static uint32_t ymodem_credit_end(void)
+{
+	uint32_t credit = (ymodem_window ? ymodem_window : 1) *
+					  (ymodem_block ? ymodem_block : YMODEM_STX_FRAME_LEN - YMODEM_FRAME_OVERHEAD);
+	uint32_t end;
+
+	if (!ymodem_compressed)
+	{
+		return rx_write_addr + credit;
+	}
+
+	// 压缩数据：已入池未解压的数据加上应答允许的数据，按固件头给出的压缩比折算输出长度。
+	// 局部压缩比更高时解压中途按需擦除（ymodem_flash_write），不会写入未擦除的页
+	end = ymodem_lz.out_addr + (rx_write_addr - ymodem_addr + credit) * ymodem_lz_ratio;
+	return (end < ymodem_erase_end) ? end : ymodem_erase_end;
+}
+
+// 运行分区（目标分区之外的另一个分区）的起始地址
+static uint32_t ymodem_base_bank(void)
+{
+	return (g_ymodem_target_addr == APP_A_SECTOR_ADDR) ? APP_B_SECTOR_ADDR : APP_A_SECTOR_ADDR;
+}
+
+/**
+ * @brief  解析首个数据包中的固件头，确定固件包格式
+ * @param  data: 数据包数据
+ * @param  len: 数据长度
+ * @param  skip: 头部之后剩余数据的偏移（输出），原始固件包为0
+ * @retval 1=继续接收 0=固件包无效（如差分包的基准固件不匹配），须取消传输
+ * @note   在写入和擦除目标分区之前调用，被拒绝的固件包不会破坏目标分区
+ */
+static uint8_t ymodem_parse_package(uint8_t *data, uint32_t len, uint32_t *skip)
+{
+	firmware_info_t info;
+	firmware_delta_t delta;
+	uint32_t head_len = sizeof(firmware_info_t);
+	uint32_t base_addr = 0;
+
+	*skip = 0;
+	ymodem_compressed = 0;
+	if (len < sizeof(firmware_info_t))
 	{
-		Q->queue[Q->rear] = x;
-		// 循环队列取模运算确保指针不会越界
-		Q->rear = (Q->rear + 1) % MAX_QUEUE_SIZE;
-		Q->count++;
 		return 1;
 	}
+
+	memcpy(&info, data, sizeof(firmware_info_t));
+	if (info.magic != FIRMWARE_MAGIC ||
+		!(info.reserved1 & (FIRMWARE_FLAG_COMPRESSED | FIRMWARE_FLAG_DELTA)))
+	{
+		return 1; // 原始固件包，整个文件原样写入
+	}
+
+	if (info.firmware_size > ymodem_bank_end - ymodem_addr - sizeof(firmware_info_t))
+	{
+		return 0;
+	}
+
+	if (info.reserved1 & FIRMWARE_FLAG_DELTA)
+	{
+		if (len < head_len + sizeof(firmware_delta_t))
+		{
+			return 0;
+		}
+		memcpy(&delta, data + head_len, sizeof(firmware_delta_t));
+		head_len += sizeof(firmware_delta_t);
+
+		// 基准固件在另一个分区（当前运行的固件），内容必须与生成差分包时一致
+		base_addr = ymodem_base_bank();
+		if (delta.base_size > APP_BANK_SIZE - sizeof(firmware_info_t) ||
+			crc32_calculate_flash(base_addr + sizeof(firmware_info_t), delta.base_size) != delta.base_crc32)
+		{
+			return 0;
+		}
+	}
+
+	// 固件头原样写入（差分扩展头不写入），之后的数据解压到头部后面
+	if (!ymodem_flash_write(ymodem_addr, data, sizeof(firmware_info_t)))
+	{
+		return 0;
+	}
+	lz_stream_init(&ymodem_lz, ymodem_addr + sizeof(firmware_info_t), info.firmware_size,
+				   ymodem_flash_write);
+	if (base_addr != 0)
+	{
+		lz_stream_set_dict(&ymodem_lz, base_addr + sizeof(firmware_info_t), delta.base_size);
+	}
+
+	// 擦除范围按解压后的大小计算
+	ymodem_erase_end = ymodem_addr + ((sizeof(firmware_info_t) + info.firmware_size + FLASH_SECTOR_SIZE - 1) /
+									  FLASH_SECTOR_SIZE) * FLASH_SECTOR_SIZE;
+	// 按整个包的平均压缩比（向上取整，加一倍余量）预估擦除量，首个应答不必等待整个输出范围擦除
+	ymodem_lz_ratio = (g_ymodem_file_size > head_len)
+						  ? 2 * ((info.firmware_size + g_ymodem_file_size - head_len - 1) / (g_ymodem_file_size - head_len))
+						  : 1;
+	if (ymodem_lz_ratio == 0)
+	{
+		ymodem_lz_ratio = 1;
+	}
+	ymodem_compressed = 1;
+	*skip = head_len;
+	return 1;
+}
+
+// 文件第page页的有效长度（最后一页可能不满一页）
+static uint32_t ymodem_page_len(uint8_t page)
+{
+	uint32_t offset = (uint32_t)page * FLASH_SECTOR_SIZE;
+
+	return (g_ymodem_file_size - offset > FLASH_SECTOR_SIZE) ? FLASH_SECTOR_SIZE : g_ymodem_file_size - offset;
+}
+
+// 差异页传输：上报目标分区和运行分区文件覆盖范围内每页的CRC32
+static void ymodem_send_page_crc(void)
+{
+	uint32_t crc[2 * (APP_BANK_SIZE / FLASH_SECTOR_SIZE)];
+	uint32_t base = ymodem_base_bank();
+	uint8_t i;
+
+	for (i = 0; i < ymodem_pages; i++)
+	{
+		crc[i] = crc32_calculate_flash(g_ymodem_target_addr + i * FLASH_SECTOR_SIZE, ymodem_page_len(i));
+		crc[ymodem_pages + i] = crc32_calculate_flash(base + i * FLASH_SECTOR_SIZE, ymodem_page_len(i));
+	}
+	ymodem_send_ext(YMODEM_EXT_PAGE_CRC, (uint8_t *)crc, ymodem_pages * 8);
+}
+
+// 差异页传输：写指针位于页边界时跳到下一个需要传输的页
+static void ymodem_skip_pages(void)
+{
+	uint32_t offset = ymodem_addr - g_ymodem_target_addr;
+	uint8_t page = offset / FLASH_SECTOR_SIZE;
+
+	if (offset % FLASH_SECTOR_SIZE != 0)
+	{
+		return;
+	}
+
+	while (page < ymodem_pages && ymodem_page_map[page] != YMODEM_PAGE_SEND)
+	{
+		page++;
+	}
+	offset = (page < ymodem_pages) ? (uint32_t)page * FLASH_SECTOR_SIZE : g_ymodem_file_size;
+
+	// 跳过的页执行页计划时已是最终内容，直接从Flash累计CRC32
+	ymodem_crc_feed(ymodem_addr, (const uint8_t *)ymodem_addr, g_ymodem_target_addr + offset - ymodem_addr);
+	ymodem_addr = g_ymodem_target_addr + offset;
+	g_ymodem_byte_count = offset;
+}
+
+/**
+ * @brief  执行差异页传输的页计划
+ * @param  map: 每页处理方式（YMODEM_PAGE_xxx）
+ * @param  len: 页数
+ * @retval 1=成功 0=失败
+ * @note   发送方等待应答期间线路空闲，一次擦除所有要写入的页并完成复制，
+ *         之后数据包依次写入各SEND页，写入时不再按写指针擦除（否则会擦掉保留的页）
+ */
+static uint8_t ymodem_apply_page_map(const uint8_t *map, uint16_t len)
+{
+	uint32_t base = ymodem_base_bank();
+	uint32_t send_bytes = 0;
+	uint32_t addr;
+	uint8_t i;
+
+	if (len != ymodem_pages)
+	{
+		return 0;
+	}
+
+	for (i = 0; i < len; i++)
+	{
+		addr = g_ymodem_target_addr + i * FLASH_SECTOR_SIZE;
+		switch (map[i])
+		{
+		case YMODEM_PAGE_KEEP:
+			break;
+
+		case YMODEM_PAGE_COPY:
+			if (!mcu_flash_erase(addr, 1) ||
+				!mcu_flash_write(addr, (uint8_t *)(base + i * FLASH_SECTOR_SIZE), FLASH_SECTOR_SIZE) ||
+				memcmp((const void *)addr, (const void *)(base + i * FLASH_SECTOR_SIZE), FLASH_SECTOR_SIZE) != 0)
+			{
+				return 0;
+			}
+			break;
+
+		case YMODEM_PAGE_SEND:
+			if (!mcu_flash_erase(addr, 1))
+			{
+				return 0;
+			}
+			send_bytes += ymodem_page_len(i);
+			break;
+
+		case YMODEM_PAGE_ERASE:
+			if (!mcu_flash_erase(addr, 1))
+			{
+				return 0;
+			}
+			break;
+
+		default:
+			return 0;
+		}
+		ymodem_page_map[i] = map[i];
+	}
+
+	// 目标分区内容已改变，续传记录作废
+	resume_journal_close();
+
+	ymodem_sparse = 1;
+	ymodem_sparse_left = send_bytes;
+	ymodem_erase_addr = ymodem_erase_end;
+	// 首页未传输说明固件头与目标分区或运行分区中的相同，无需解析
+	ymodem_header_pending = (map[0] == YMODEM_PAGE_SEND);
+	ymodem_addr = g_ymodem_target_addr;
+	ymodem_skip_pages();
+
+	// 中断按收到的数据量累计写入地址来判断文件是否收完，按实际要传输的字节数折算
+	__disable_irq();
+	rx_write_addr = g_ymodem_target_addr + g_ymodem_file_size - send_bytes;
+	__enable_irq();
+	return 1;
 }
 
-// 出队列
-int queue_delete(seq_queue_t *Q, uint8_t *d)
+/**
+ * @brief  原始固件包数据写入Flash并推进写指针
+ * @param  data: 数据
+ * @param  len: 数据长度
+ * @retval 1=成功 0=写Flash失败
+ * @note   差异页传输时一个大数据块可能跨越多个SEND页，按页拆开写入，每页写完跳到下一个SEND页
+ */
+static uint8_t ymodem_write_data(uint8_t *data, uint32_t len)
 {
-	if (Q->count == 0)
+	uint32_t chunk;
+	uint32_t page_left;
+
+	while (len > 0)
+	{
+		chunk = len;
+		if (ymodem_sparse)
+		{
+			page_left = FLASH_SECTOR_SIZE - (ymodem_addr - g_ymodem_target_addr) % FLASH_SECTOR_SIZE;
+			if (chunk > page_left)
+			{
+				chunk = page_left;
+			}
+		}
+
+		// 正常情况下应答前已擦除，写入函数兜底保证目标页已擦除
+		if (!ymodem_flash_write(ymodem_addr, data, chunk))
+		{
+			return 0;
+		}
+		ymodem_addr += chunk;
+		g_ymodem_byte_count += chunk;
+		data += chunk;
+		len -= chunk;
+
+		if (ymodem_journal)
+		{
+			resume_journal_commit(g_ymodem_byte_count);
+		}
+		if (ymodem_sparse)
+		{
+			ymodem_sparse_left -= chunk;
+			ymodem_skip_pages();
+		}
+	}
+	return 1;
+}
+
+/**
+ * @brief  擦除区跳过：不写入，直接把写指针移过一段0xFF
+ * @param  offset: 跳过区域的文件偏移
+ * @param  len: 跳过长度
+ * @retval 1=成功 0=拒绝（发送方改为正常发送该段）
+ * @note   发送方等待应答期间线路空闲，擦除跳过区域覆盖的页；
+ *         压缩包、页计划和广播会话中的写入位置与文件偏移不对应，不支持跳过
+ */
+static uint8_t ymodem_skip_erased(uint32_t offset, uint32_t len)
+{
+	// 应答丢失后重发的SKIP帧
+	if (len > 0 && offset + len == g_ymodem_byte_count)
+	{
+		return 1;
+	}
+
+	if (ymodem_compressed || ymodem_sparse || ymodem_bcast || ymodem_header_pending ||
+		offset != g_ymodem_byte_count || len > g_ymodem_file_size - offset ||
+		((len & 1) && offset + len < g_ymodem_file_size)) // 之后的数据须半字对齐
+	{
+		return 0;
+	}
+
+	if (!ymodem_erase_ahead(ymodem_addr + len))
+	{
+		return 0;
+	}
+	ymodem_crc_feed(ymodem_addr, (const uint8_t *)ymodem_addr, len);
+	ymodem_addr += len;
+	g_ymodem_byte_count += len;
+
+	__disable_irq();
+	rx_write_addr += len;
+	__enable_irq();
+
+	if (ymodem_journal)
+	{
+		resume_journal_commit(g_ymodem_byte_count);
+	}
+	return 1;
+}
+
+// 广播会话全部数据包都已写入时的位图
+static uint32_t ymodem_bcast_full(void)
+{
+	return (ymodem_bcast_packets >= 32) ? 0xFFFFFFFF : ((1UL << ymodem_bcast_packets) - 1);
+}
+
+/**
+ * @brief  广播会话：按序号把数据包写入对应位置
+ * @param  p: 数据包
+ * @retval 1=成功（已写入过的补发包直接跳过） 0=写Flash失败或回读不一致
+ * @note   广播会话只使用1024字节数据包，第n包写入文件偏移(n-1)*1024处
+ */
+static uint8_t ymodem_bcast_write(const download_buf_t *p)
+{
+	uint8_t idx = p->data[1] - 1;
+	uint32_t offset = (uint32_t)idx * FLASH_SECTOR_SIZE;
+	uint32_t len;
+
+	if (p->data[0] != YMODEM_STX || (ymodem_bcast_map & (1UL << idx)))
+	{
+		return 1;
+	}
+
+	len = g_ymodem_file_size - offset;
+	if (len > FLASH_SECTOR_SIZE)
+	{
+		len = FLASH_SECTOR_SIZE;
+	}
+	if (!mcu_flash_write(g_ymodem_target_addr + offset, (uint8_t *)&p->data[3], len) ||
+		memcmp((const void *)(g_ymodem_target_addr + offset), &p->data[3], len) != 0)
+	{
+		return 0;
+	}
+
+	ymodem_bcast_map |= 1UL << idx;
+	g_ymodem_byte_count += len;
+	return 1;
+}
+
+// 应答POLL：节点号 + 接收状态 + 已收数据包位图
+static void ymodem_node_report(void)
+{
+	uint8_t buf[6];
+
+	buf[0] = ymodem_node_id;
+	buf[1] = ymodem_status;
+	memcpy(&buf[2], &ymodem_bcast_map, 4);
+
+	ymodem_polled = 1;
+	ymodem_send_ext(YMODEM_EXT_POLL, buf, sizeof(buf));
+	ymodem_polled = 0;
+	ymodem_reported = 1;
+}
+
+uint8_t type;
+// YMODEM数据接收处理函数
+static void ymodem_recv(download_buf_t *p)
+{
+	if (p->len == 0)
+		return;
+
+	type = p->data[0];
+
+	// 波特率切换中：只接受测试帧
+	if (ymodem_baud_wait)
+	{
+		ymodem_baud_test(p);
+		return;
+	}
+
+	// 多机总线：查询本节点的接收状态，任何阶段都应答
+	if (type == YMODEM_EXT && p->data[1] == YMODEM_EXT_POLL)
+	{
+		if (p->len == YMODEM_EXT_OVERHEAD + 1 && p->data[4] == ymodem_node_id)
+		{
+			ymodem_node_report();
+		}
+		p->len = 0;
+		return;
+	}
+
+	switch (ymodem_status)
+	{
+	case 0: // 等待起始帧
+		if (type == YMODEM_SOH)
+		{
+			ymodem_addr = g_ymodem_target_addr;
+			g_ymodem_byte_count = 0; // 重置计数器
+			ymodem_packet_count = 0; // 重置数据包计数
+			ymodem_bcast = (ymodem_node_state == NODE_BROADCAST);
+
+			// 解析文件大小（Ymodem第一个数据包包含文件名和大小）
+			// 跳过文件名，找到文件大小
+			uint8_t *size_str = &p->data[3];
+			// 跳过文件名（找到第一个\0）
+			while (*size_str != 0 && size_str < &p->data[3 + 128])
+			{
+				size_str++;
+			}
+			size_str++; // 跳过\0
+
+			// 解析文件大小（ASCII十进制）
+			g_ymodem_file_size = 0;
+			while (*size_str >= '0' && *size_str <= '9')
+			{
+				g_ymodem_file_size = g_ymodem_file_size * 10 + (*size_str - '0');
+				size_str++;
+			}
+
+			// 文件大小字段之后为扩展选项区（标准发送方此处为全0）
+			uint8_t *opts = size_str;
+			uint8_t *opts_end = &p->data[3 + 128];
+			while (opts < opts_end && *opts != 0)
+			{
+				opts++;
+			}
+			opts++;
+
+			uint8_t reply[64];
+			uint16_t reply_len = 0;
+			uint32_t value;
+
+			// 数据包序号从1开始
+			rx_expect_seq = 1;
+			rx_present = 0;
+			rx_nak_sent = 0;
+
+			// 滑动窗口协商（流式模式不逐包应答，不支持窗口）
+			ymodem_window = 0;
+			if (opts < opts_end && ymodem_get_option(opts, opts_end, "win", &value))
+			{
+				if (value > YMODEM_WINDOW_MAX)
+				{
+					value = YMODEM_WINDOW_MAX;
+				}
+				if (ymodem_stream || value < 2)
+				{
+					value = 0;
+				}
+				reply_len = ymodem_put_option(reply, reply_len, "win", value);
+				ymodem_window = value;
+			}
+
+			// 大数据块协商：取不超过上限的整页大小，不大于1024字节时沿用STX数据包。
+			// 流式模式没有应答流控，大数据块会很快占满缓冲池，不支持
+			ymodem_block = 0;
+			if (opts < opts_end && ymodem_get_option(opts, opts_end, "blk", &value))
+			{
+				if (value > YMODEM_BLOCK_MAX)
+				{
+					value = YMODEM_BLOCK_MAX;
+				}
+				value -= value % FLASH_SECTOR_SIZE;
+				if (ymodem_stream || value <= YMODEM_STX_FRAME_LEN - YMODEM_FRAME_OVERHEAD)
+				{
+					value = 0;
+				}
+				reply_len = ymodem_put_option(reply, reply_len, "blk", value);
+				ymodem_block = value;
+			}
+
+			// 波特率协商：应答仍以默认波特率发出，之后再切换
+			uint32_t new_baud = DEBUG_USART_BAUDRATE;
+			if (opts < opts_end && ymodem_get_option(opts, opts_end, "baud", &value))
+			{
+				new_baud = ymodem_baud_select(value);
+				reply_len = ymodem_put_option(reply, reply_len, "baud", new_baud);
+			}
+
+			// 差异页传输：应答文件页数并上报逐页CRC32，流式模式不支持
+			ymodem_pages = 0;
+			ymodem_sparse = 0;
+			if (opts < opts_end && ymodem_get_option(opts, opts_end, "pages", &value))
+			{
+				value = (g_ymodem_file_size + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE;
+				if (!ymodem_stream && value <= APP_BANK_SIZE / FLASH_SECTOR_SIZE)
+				{
+					ymodem_pages = value;
+				}
+				reply_len = ymodem_put_option(reply, reply_len, "pages", ymodem_pages);
+			}
+
+			// 断点续传：查找同一文件写入同一分区的记录，应答水位，发送方从该处继续。
+			// 流式模式无法在传输中途擦除日志页，差异页传输已跳过相同的页，均不使用续传
+			uint32_t resume_at = 0;
+			ymodem_resume_req = 0;
+			ymodem_journal = 0;
+			if (opts < opts_end && ymodem_get_option(opts, opts_end, "resume", &value))
+			{
+				if (!ymodem_stream && !ymodem_pages)
+				{
+					ymodem_resume_req = 1;
+					ymodem_resume_id = value;
+					resume_at = resume_journal_find(value, g_ymodem_file_size, ymodem_addr);
+				}
+				reply_len = ymodem_put_option(reply, reply_len, "resume", resume_at);
+			}
+
+			// 应用程序区域大小（根据目标地址计算扇区数）
+			uint16_t erase_sectors;
+			if (ymodem_addr == APP_A_SECTOR_ADDR)
+			{
+				erase_sectors = APP_A_ERASE_SECTORS; // 20KB
+			}
+			else if (ymodem_addr == APP_B_SECTOR_ADDR)
+			{
+				erase_sectors = APP_B_ERASE_SECTORS; // 20KB
+			}
+			else
+			{
+				erase_sectors = APP_ERASE_SECTORS; // 默认20KB
+			}
+
+			// 只擦除文件覆盖的页，大小未知时按整个分区处理
+			uint32_t file_pages = (g_ymodem_file_size + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE;
+			if (file_pages == 0 || file_pages > erase_sectors)
+			{
+				file_pages = erase_sectors;
+			}
+			ymodem_erase_addr = ymodem_addr;
+			ymodem_erase_end = ymodem_addr + file_pages * FLASH_SECTOR_SIZE;
+			ymodem_bank_end = ymodem_addr + erase_sectors * FLASH_SECTOR_SIZE;
+			rx_write_addr = ymodem_addr;
+			rx_granted = ymodem_window;
+			ymodem_compressed = 0;
+			ymodem_header_pending = 1;
+			crc32_init(&ymodem_crc);
+			ymodem_crc_addr = ymodem_addr + sizeof(firmware_info_t);
+#if CRC32_USE_HW
+			crc32_native_init(&ymodem_hw_crc);
+			ymodem_hw_crc_addr = ymodem_crc_addr;
+#endif
+
+			if (ymodem_bcast)
+			{
+				// 广播会话：数据包可能乱序到达（补发），不解析固件头，不续传。
+				// 起始帧处理时一次擦除文件覆盖的全部页，发送方等待擦除完成后再广播数据包
+				ymodem_bcast_map = 0;
+				ymodem_bcast_packets = (g_ymodem_file_size + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE;
+				ymodem_header_pending = 0;
+				ymodem_crc_addr = 0;
+				if (ymodem_bcast_packets == 0 || ymodem_bcast_packets > YMODEM_BCAST_MAX_PACKETS ||
+					!ymodem_erase_ahead(ymodem_erase_end))
+				{
+					ymodem_abort_transfer();
+					break;
+				}
+				resume_journal_close();
+			}
+
+			if (resume_at > 0)
+			{
+				// 固件头和水位之前的数据已在Flash中，从水位所在页开始擦写
+				ymodem_crc_feed(ymodem_addr, (const uint8_t *)ymodem_addr, resume_at);
+				ymodem_addr += resume_at;
+				g_ymodem_byte_count = resume_at;
+				ymodem_erase_addr = ymodem_addr;
+				rx_write_addr = ymodem_addr;
+				ymodem_header_pending = 0;
+				ymodem_journal = 1;
+			}
+
+			// 起始帧应答前不擦除：首包的固件头校验通过（差分包须先核对基准固件）后，
+			// 由写入函数按写指针逐页擦除，首包应答时间与文件大小无关。
+			// 流式模式在首包处一次擦除全部覆盖页后才应答，见数据帧处理
+
+			ymodem_ack();
+			// 发送方带了扩展选项：先回复接受的选项，再发握手字符
+			if (opts < opts_end && *opts != 0)
+			{
+				ymodem_send_ext(YMODEM_EXT_OPTIONS, reply, reply_len);
+			}
+			if (ymodem_pages)
+			{
+				ymodem_send_page_crc();
+			}
+
+			if (new_baud != DEBUG_USART_BAUDRATE)
+			{
+				// 切换后等待发送方的测试帧，确认通过再发握手字符
+				ymodem_set_baudrate(new_baud);
+				ymodem_baud_wait = YMODEM_BAUD_TEST_TIMEOUT;
+			}
+			else
+			{
+				ymodem_handshake();
+			}
+			ymodem_status++;
+		}
+		break;
+
+	case 1: // 接收数据帧
+		if (ymodem_bcast && ymodem_is_data(type))
+		{
+			if (!ymodem_bcast_write(p))
+			{
+				ymodem_abort_transfer();
+				break;
+			}
+		}
+		else if (ymodem_is_data(type))
+		{
+			uint16_t block_size = p->len - YMODEM_FRAME_OVERHEAD;
+
+			// 计算实际需要写入的字节数（差异页传输按页计划中剩余的SEND页计算）
+			uint32_t bytes_to_write = block_size;
+			uint32_t remaining = ymodem_sparse ? ymodem_sparse_left : g_ymodem_file_size - g_ymodem_byte_count;
+
+			if (remaining < block_size)
+			{
+				bytes_to_write = remaining; // 最后一个数据块，只写入剩余字节
+			}
+
+			uint8_t *data = &p->data[3];
+			uint32_t skip = 0;
+
+			// 首包带固件头：确定固件包格式后才放行应答
+			if (ymodem_header_pending)
+			{
+				if (!ymodem_parse_package(data, bytes_to_write, &skip))
+				{
+					ymodem_abort_transfer();
+					break;
+				}
+				ymodem_header_pending = 0;
+
+				// 压缩包解压后的内容与页无法对应，不能按页计划写入
+				if (ymodem_sparse && ymodem_compressed)
+				{
+					ymodem_abort_transfer();
+					break;
+				}
+
+				// 新的下载：原始固件包开始记录水位（线路空闲，可以擦除日志页），
+				// 否则作废旧记录，目标分区即将被覆盖
+				if (ymodem_resume_req && !ymodem_compressed)
+				{
+					ymodem_journal = resume_journal_open(ymodem_resume_id, g_ymodem_file_size,
+														 g_ymodem_target_addr);
+				}
+				else
+				{
+					resume_journal_close();
+				}
+
+				// 流式模式：发送方发出首包后等待应答，之后的数据包连续发送、无法暂停，
+				// 逐页擦除时CPU停顿期间只有DMA接收缓冲区在收数据，必然溢出。
+				// 固件头校验通过（差分包已核对基准固件）后先擦除全部覆盖页，再应答放行
+				if (ymodem_stream)
+				{
+					if (!ymodem_erase_ahead(ymodem_erase_end))
+					{
+						ymodem_abort_transfer();
+						break;
+					}
+					ymodem_ack();
+				}
+			}
+
+			if (bytes_to_write > 0)
+			{
+				uint8_t ok;
+
+				if (ymodem_compressed)
+				{
+					// 解压完成后剩余的输入（末包填充）被忽略
+					ok = lz_stream_feed(&ymodem_lz, data + skip, bytes_to_write - skip) != LZ_STREAM_ERROR;
+					ymodem_addr += bytes_to_write;
+					g_ymodem_byte_count += bytes_to_write;
+				}
+				else
+				{
+					ok = ymodem_write_data(data, bytes_to_write);
+				}
+
+				if (!ok)
+				{
+					// 数据包已提前应答，写入失败只能取消本次传输
+					ymodem_abort_transfer();
+					break;
+				}
+			}
+
+			// ==== 调试： ====
+			//			ymodem_packet_count++;
+
+			// 数据包在组帧校验通过时已应答，这里不再应答
+		}
+		else if (type == YMODEM_EXT)
+		{
+			// 差异页传输的页计划在第一个数据包之前到达；应答丢失后重发的页计划只补发应答
+			if (p->data[1] == YMODEM_EXT_PAGE_MAP && ymodem_pages)
+			{
+				uint8_t ok = ymodem_sparse ||
+							 ymodem_apply_page_map(&p->data[4], p->len - YMODEM_EXT_OVERHEAD);
+
+				ymodem_send_ext(YMODEM_EXT_PAGE_MAP, &ok, 1);
+				if (!ok)
+				{
+					ymodem_abort_transfer();
+				}
+			}
+			else if (p->data[1] == YMODEM_EXT_SKIP && p->len == YMODEM_EXT_OVERHEAD + 8)
+			{
+				uint32_t skip_offset;
+				uint32_t skip_len;
+				uint8_t ok;
+
+				memcpy(&skip_offset, &p->data[4], 4);
+				memcpy(&skip_len, &p->data[8], 4);
+				ok = ymodem_skip_erased(skip_offset, skip_len);
+				ymodem_send_ext(YMODEM_EXT_SKIP, &ok, 1);
+			}
+		}
+		else if (type == YMODEM_EOT) // 传输结束
+		{
+			// 广播会话：数据包未收齐时忽略结束帧，等待补发
+			if (ymodem_bcast && ymodem_bcast_map != ymodem_bcast_full())
+			{
+				break;
+			}
+
+			// 发送方收齐所有应答后才发EOT，之后的帧恢复标准应答方式
+			ymodem_window = 0;
+			ymodem_nack();
+			ymodem_status++;
+		}
+		else
+		{
+			ymodem_status = 0;
+			g_ymodem_success = 0; // 标记失败
+		}
+		break;
+
+	case 2: // 确认传输结束
+		if (type == YMODEM_EOT)
+		{
+			ymodem_ack();
+			ymodem_handshake();
+			g_ymodem_success = 1; // 标记成功
+
+			// 文件已完整写入，续传记录作废
+			if (ymodem_journal)
+			{
+				resume_journal_close();
+				ymodem_journal = 0;
+			}
+
+			// 传输结束，恢复默认波特率
+			ymodem_set_baudrate(DEBUG_USART_BAUDRATE);
+
+			ymodem_status++;
+		}
+		break;
+
+	case 3: // 接收结束帧
+		if (type == YMODEM_SOH)
+		{
+			ymodem_ack();
+			ymodem_end();
+			ymodem_status = 0;
+			// 固件更新完成，LED闪烁指示
+		}
+		else
+		{
+			ymodem_status = 0;
+		}
+		break;
+	}
+
+	// 清空缓冲区
+	p->len = 0;
+}
+
+// 根据帧头字节确定整帧长度，0表示不是帧头
+static uint16_t ymodem_frame_length(uint8_t head)
+{
+	switch (head)
+	{
+	case YMODEM_SOH:
+		return YMODEM_SOH_FRAME_LEN;
+	case YMODEM_STX:
+		return YMODEM_STX_FRAME_LEN;
+	case YMODEM_BLK:
+		return ymodem_block ? ymodem_block + YMODEM_FRAME_OVERHEAD : 0; // 未协商时视为杂散字节
+	case YMODEM_EOT:
+	case YMODEM_CA:
+		return 1;
+	case YMODEM_EXT:
+		return YMODEM_EXT_OVERHEAD; // 收到长度字段后再确定实际长度
+	default:
+		return 0;
+	}
+}
+
+// 分配缓冲池槽位：offset为相对写入位置的偏移（窗口模式下按序号定位），无空闲槽位返回NULL
+static download_buf_t *ymodem_slot_alloc(uint8_t offset)
+{
+	uint8_t used = pkt_pool.head - pkt_pool.tail;
+
+	if (ymodem_abort || offset >= YMODEM_PKT_POOL_SIZE - used)
+	{
+		return NULL;
+	}
+	return &pkt_pool.pkt[(uint8_t)(pkt_pool.head + offset) & (YMODEM_PKT_POOL_SIZE - 1)];
+}
+
+// 发送累计应答：窗口模式带序号，标准模式只发ACK
+static void ymodem_send_ack(void)
+{
+	if (ymodem_window)
+	{
+		ymodem_ack_seq(rx_expect_seq - 1);
+		rx_granted = rx_expect_seq - 1 + ymodem_window;
+	}
+	else
+	{
+		ymodem_ack();
+	}
+}
+
+// 应答允许发送的数据都将落在已擦除区域内
+static uint8_t ymodem_erase_ready(void)
+{
+	return ymodem_credit_end() <= ymodem_erase_addr || ymodem_erase_addr >= ymodem_erase_end;
+}
+
+// 发送方已停止发送：停等模式下应答推迟时发送方必然在等待，
+// 窗口模式下需收齐上次应答允许的全部数据包（或文件已收完）
+static uint8_t ymodem_line_idle(void)
+{
+	if (!ymodem_window)
+	{
+		return 1;
+	}
+	return (uint8_t)(rx_expect_seq - 1) == rx_granted ||
+		   rx_write_addr >= g_ymodem_target_addr + g_ymodem_file_size;
+}
+
+// 空闲槽位足够容纳发送方下一批在途数据包且对应Flash页已擦除时立即应答，
+// 否则推迟到主循环释放槽位、擦除后再应答；固件头未解析前也暂缓应答
+static uint8_t ymodem_ack_ready(void)
+{
+	uint8_t need = ymodem_window ? ymodem_window : 1;
+	return (uint8_t)(YMODEM_PKT_POOL_SIZE - (uint8_t)(pkt_pool.head - pkt_pool.tail)) >= need &&
+		   !ymodem_header_pending && ymodem_erase_ready();
+}
+
+// 数据包按序入池，累计写入地址
+static void ymodem_pool_push(void)
+{
+	download_buf_t *p = &pkt_pool.pkt[pkt_pool.head & (YMODEM_PKT_POOL_SIZE - 1)];
+
+	// 起始帧（SOH）不计入
+	if (ymodem_is_data(p->data[0]) && (p->data[0] != YMODEM_SOH || ymodem_status == 1))
+	{
+		rx_write_addr += p->len - YMODEM_FRAME_OVERHEAD;
+	}
+	pkt_pool.head++;
+}
+
+static void ymodem_ack_credit(void)
+{
+	if (ymodem_ack_ready())
+	{
+		ymodem_send_ack();
+	}
+	else
+	{
+		ymodem_ack_pending = 1;
+	}
+}
+
+// 多机总线：处理SELECT命令（中断中调用），被选中且尚未开始传输时发握手字符表示在线
+static void ymodem_node_select(uint8_t id)
+{
+	if (ymodem_node_id == YMODEM_NODE_P2P)
+	{
+		return;
+	}
+
+	if (id == ymodem_node_id)
+	{
+		ymodem_node_state = NODE_SELECTED;
+		if (ymodem_status == 0)
+		{
+			ymodem_handshake();
+		}
+	}
+	else if (id == YMODEM_NODE_BROADCAST)
 	{
-		return 0;
+		ymodem_node_state = NODE_BROADCAST;
 	}
 	else
 	{
-		*d = Q->queue[Q->front];
-		Q->front = (Q->front + 1) % MAX_QUEUE_SIZE;
-		Q->count--;
-		return 1;
+		ymodem_node_state = NODE_IDLE;
 	}
 }
 
-// YMODEM协议响应函数
-void ymodem_ack(void)
+// 一帧接收完毕：校验后入池并应答
+static void ymodem_frame_done(void)
 {
-	uint8_t buf = YMODEM_ACK;
-	Usart_Send_Data(&buf, 1);
-}
+	uint8_t is_data = ymodem_is_data(frame_head);
 
-void ymodem_nack(void)
-{
-	uint8_t buf = YMODEM_NAK;
-	Usart_Send_Data(&buf, 1);
-}
+	if (frame_buf == NULL)
+	{
+		// 窗口模式：已入池的重复包说明应答丢失，重发累计应答
+		if (ymodem_window && is_data && !ymodem_ack_pending &&
+			(uint8_t)(rx_expect_seq - 1 - frame_seq) < ymodem_window)
+		{
+			ymodem_send_ack();
+		}
+		return;
+	}
 
-void ymodem_c(void)
-{
-	uint8_t buf = YMODEM_C;
-	Usart_Send_Data(&buf, 1);
-	// 移除printf提示
-}
+	frame_buf->len = frame_len;
 
-void ymodem_end(void)
-{
-	uint8_t buf = YMODEM_END;
-	Usart_Send_Data(&buf, 1);
-}
-uint8_t type;
-// YMODEM数据接收处理函数
-static void ymodem_recv(download_buf_t *p)
-{
-	if (p->len == 0)
+	// 多机总线：未被选中的节点只处理扩展命令帧，其他帧不校验直接丢弃
+	if (ymodem_node_state == NODE_IDLE && frame_head != YMODEM_EXT)
+	{
 		return;
+	}
 
-	type = p->data[0];
+	if (!ymodem_frame_check(frame_buf))
+	{
+		if (!is_data)
+		{
+			return; // 扩展命令帧出错直接丢弃，由发送方超时处理
+		}
+		else if (ymodem_bcast)
+		{
+			return; // 广播会话不应答，缺失的包由发送方查询后补发
+		}
+		else if (ymodem_stream)
+		{
+			ymodem_abort_transfer(); // 流式模式无法重发，取消传输
+		}
+		else if (ymodem_window)
+		{
+			ymodem_nack_seq(rx_expect_seq + frame_offset); // 只重发这一包
+		}
+		else
+		{
+			ymodem_nack(); // CRC错误，请求重发
+		}
+		return;
+	}
 
-	switch (ymodem_status)
+	if (frame_head == YMODEM_EXT)
 	{
-	case 0: // 等待起始帧
-		if (type == YMODEM_SOH)
+		if (frame_buf->data[1] == YMODEM_EXT_SELECT && frame_len == YMODEM_EXT_OVERHEAD + 1)
 		{
-			ymodem_addr = g_ymodem_target_addr;
-			g_ymodem_byte_count = 0; // 重置计数器
-			ymodem_packet_count = 0; // 重置数据包计数
+			ymodem_node_select(frame_buf->data[4]);
+			return;
+		}
+		if (ymodem_node_state == NODE_IDLE && frame_buf->data[1] != YMODEM_EXT_POLL)
+		{
+			return;
+		}
+	}
 
-			// 解析文件大小（Ymodem第一个数据包包含文件名和大小）
-			// 跳过文件名，找到文件大小
-			uint8_t *size_str = &p->data[3];
-			// 跳过文件名（找到第一个\0）
-			while (*size_str != 0 && size_str < &p->data[3 + 128])
-			{
-				size_str++;
-			}
-			size_str++; // 跳过\0
+	// 广播会话：数据包可能乱序（补发），序号在文件范围内即入池，由主循环按序号定位写入
+	if (ymodem_bcast && is_data && ymodem_status == 1)
+	{
+		if ((uint8_t)(frame_buf->data[1] - 1) < ymodem_bcast_packets)
+		{
+			ymodem_pool_push();
+		}
+		return;
+	}
 
-			// 解析文件大小（ASCII十进制）
-			g_ymodem_file_size = 0;
-			while (*size_str >= '0' && *size_str <= '9')
+	if (ymodem_window && is_data)
+	{
+		rx_present |= 1 << frame_offset;
+		if (frame_offset != 0)
+		{
+			// 窗口前沿的数据包缺失，请求单独重发一次，后续包先保留在槽位中
+			if (!rx_nak_sent)
 			{
-				g_ymodem_file_size = g_ymodem_file_size * 10 + (*size_str - '0');
-				size_str++;
+				ymodem_nack_seq(rx_expect_seq);
+				rx_nak_sent = 1;
 			}
-			// 擦除应用程序区域（根据目标地址计算擦除扇区数）
-			uint16_t erase_sectors;
-			if (ymodem_addr == APP_A_SECTOR_ADDR)
+			return;
+		}
+
+		// 窗口前沿连续到齐的数据包按序入池
+		while (rx_present & 1)
+		{
+			rx_present >>= 1;
+			rx_expect_seq++;
+			ymodem_pool_push();
+		}
+		rx_nak_sent = 0;
+		ymodem_ack_credit();
+		return;
+	}
+
+	// 数据阶段校验序号：重复包说明上次应答丢失，补发应答后丢弃，不再写Flash；
+	// 其他序号说明双方已失去同步，无法恢复，取消传输
+	if (is_data && ymodem_status == 1)
+	{
+		if (frame_buf->data[1] == (uint8_t)(rx_expect_seq - 1) && !ymodem_stream)
+		{
+			// 应答尚在推迟中则等主循环补发，避免发送方收到两个应答
+			if (!ymodem_ack_pending)
 			{
-				erase_sectors = APP_A_ERASE_SECTORS; // 20KB
+				ymodem_ack();
 			}
-			else if (ymodem_addr == APP_B_SECTOR_ADDR)
+			return;
+		}
+		if (frame_buf->data[1] != rx_expect_seq)
+		{
+			ymodem_abort_transfer();
+			return;
+		}
+		rx_expect_seq++;
+	}
+
+	ymodem_pool_push(); // 入池，交给主循环处理
+
+	// 数据阶段：数据包已安全保存在RAM中，立即应答让发送方开始发下一包，
+	// 与主循环写Flash并行；缓冲池已满则等主循环释放槽位后再应答。
+	// 流式模式不逐包应答
+	if (ymodem_status == 1 && !ymodem_stream && is_data)
+	{
+		ymodem_ack_credit();
+	}
+}
+
+// 组帧：处理帧头、序号和长度字段中的一个字节（帧体由ymodem_frame_parse整段复制）
+static void ymodem_frame_byte(uint8_t ch)
+{
+	if (frame_expect == 0)
+	{
+		frame_expect = ymodem_frame_length(ch);
+		if (frame_expect == 0)
+		{
+			return; // 帧间的杂散字节，丢弃
+		}
+		frame_len = 0;
+		frame_head = ch;
+		frame_offset = 0;
+		frame_buf = NULL;
+
+		// 窗口模式的数据帧收到序号后再按序号分配槽位
+		if (!(ymodem_window && ymodem_is_data(ch)))
+		{
+			// 缓冲池已满时丢弃该帧，发送方超时后会重发；
+			// 已取消的传输在主循环重新握手前丢弃所有帧。
+			// 窗口内保留着乱序数据包时，它们的槽位按序号相对写入位置定位，
+			// 其他帧入池会使其错位：丢弃该帧，发送方超时重发时窗口已收齐
+			frame_buf = (rx_present != 0) ? NULL : ymodem_slot_alloc(0);
+			// 流式模式没有重发机制，主循环跟不上接收速度只能取消
+			if (frame_buf == NULL && ymodem_stream && !ymodem_bcast && !ymodem_abort)
 			{
-				erase_sectors = APP_B_ERASE_SECTORS; // 20KB
+				ymodem_abort_transfer();
 			}
-			else
+		}
+	}
+	else if (frame_len == 1 && ymodem_window && ymodem_is_data(frame_head))
+	{
+		// 窗口内的序号放到对应槽位，窗口外或已收到的包丢弃
+		frame_seq = ch;
+		frame_offset = (uint8_t)(ch - rx_expect_seq);
+		if (frame_offset < ymodem_window && !(rx_present & (1 << frame_offset)))
+		{
+			frame_buf = ymodem_slot_alloc(frame_offset);
+			if (frame_buf != NULL)
 			{
-				erase_sectors = APP_ERASE_SECTORS; // 默认20KB
+				frame_buf->data[0] = frame_head;
 			}
-			mcu_flash_erase(ymodem_addr, erase_sectors);
-
-			ymodem_ack();
-			ymodem_c();
-			ymodem_status++;
 		}
-		break;
+	}
 
-	case 1: // 接收数据帧
-		if (type == YMODEM_SOH || type == YMODEM_STX)
+	else if (frame_len == 3 && frame_head == YMODEM_EXT)
+	{
+		// 扩展命令帧收到长度高字节后确定帧长，超出缓冲区的视为杂散数据丢弃
+		frame_expect = YMODEM_EXT_OVERHEAD + (frame_buf != NULL ? frame_buf->data[2] : 0) + ((uint16_t)ch << 8);
+		if (frame_buf == NULL || frame_expect > sizeof(frame_buf->data))
 		{
-			uint16_t block_size = (type == YMODEM_SOH) ? 128 : 1024;
+			frame_expect = 0;
+			return;
+		}
+	}
 
-			// 计算实际需要写入的字节数
-			uint32_t bytes_to_write = block_size;
-			uint32_t remaining = g_ymodem_file_size - g_ymodem_byte_count;
+	if (frame_buf != NULL)
+	{
+		frame_buf->data[frame_len] = ch;
+	}
+	frame_len++;
 
-			if (remaining < block_size)
-			{
-				bytes_to_write = remaining; // 最后一个数据块，只写入剩余字节
-			}
+	if (frame_len == frame_expect)
+	{
+		frame_expect = 0;
+		ymodem_frame_done();
+	}
+}
 
-			if (bytes_to_write > 0)
-			{
-				mcu_flash_write(ymodem_addr, &p->data[3], bytes_to_write);
-				ymodem_addr += bytes_to_write;
-				g_ymodem_byte_count += bytes_to_write;
-			}
+// 帧头、序号和长度字段之后的部分不需要逐字节判断
+#define YMODEM_FRAME_BODY_START 4
 
-			// ==== 调试： ====
-			//			ymodem_packet_count++;
+// 组帧：原地解析一段接收数据，帧体整段复制到缓冲池槽位（唯一一次复制），收齐一帧立即入池
+static void ymodem_frame_input(const uint8_t *data, uint16_t len)
+{
+	uint16_t i = 0;
+	uint16_t n;
 
-			ymodem_ack();
+	while (i < len)
+	{
+		if (frame_expect == 0 || frame_len < YMODEM_FRAME_BODY_START)
+		{
+			ymodem_frame_byte(data[i++]);
+			continue;
 		}
-		else if (type == YMODEM_EOT) // 传输结束
+
+		n = frame_expect - frame_len;
+		if (n > len - i)
 		{
-			ymodem_nack();
-			ymodem_status++;
+			n = len - i;
 		}
-		else
+		if (frame_buf != NULL)
 		{
-			ymodem_status = 0;
-			g_ymodem_success = 0; // 标记失败
+			memcpy(&frame_buf->data[frame_len], &data[i], n);
 		}
-		break;
+		frame_len += n;
+		i += n;
 
-	case 2: // 确认传输结束
-		if (type == YMODEM_EOT)
+		if (frame_len == frame_expect)
 		{
-			ymodem_ack();
-			ymodem_c();
-			g_ymodem_success = 1; // 标记成功
-
-			ymodem_status++;
+			frame_expect = 0;
+			ymodem_frame_done();
 		}
-		break;
+	}
+}
 
-	case 3: // 接收结束帧
-		if (type == YMODEM_SOH)
+// 补发因空闲槽位不足或待擦除而推迟的应答
+static void ymodem_ack_flush(void)
+{
+	if (!ymodem_ack_pending)
+	{
+		return;
+	}
+
+	// 发送方已停下等待应答，趁线路空闲擦除应答后将要写入的页
+	if (!ymodem_erase_ready() && ymodem_line_idle())
+	{
+		if (!ymodem_erase_ahead(ymodem_credit_end()))
 		{
-			ymodem_ack();
-			ymodem_end();
-			ymodem_status = 0;
-			// 固件更新完成，LED闪烁指示
+			ymodem_abort_transfer();
+			return;
 		}
-		else
+	}
+
+	__disable_irq();
+	if (ymodem_ack_pending && ymodem_ack_ready())
+	{
+		ymodem_ack_pending = 0;
+		ymodem_send_ack();
+	}
+	__enable_irq();
+}
+
+/**
+ * @brief  处理缓冲池中已接收完整的数据包
+ * @param  None
+ * @retval None
+ * @note   在主循环中调用，Flash擦写和应答都在这里完成，不占用中断
+ */
+void ymodem_process(void)
+{
+	// 传输被取消：丢弃残留数据包，重新握手等待发送方重新开始
+	if (ymodem_abort)
+	{
+		ymodem_reset();
+		ymodem_handshake();
+		return;
+	}
+
+	while (pkt_pool.tail != pkt_pool.head && !ymodem_abort)
+	{
+		download_buf_t *p = &pkt_pool.pkt[pkt_pool.tail & (YMODEM_PKT_POOL_SIZE - 1)];
+
+		// 首个数据包会开始擦写目标分区，等发送方停下后再处理
+		if (ymodem_header_pending && ymodem_status == 1 &&
+			ymodem_is_data(p->data[0]) && !ymodem_line_idle())
 		{
-			ymodem_status = 0;
+			break;
 		}
-		break;
+
+		ymodem_recv(p);
+		pkt_pool.tail++; // 释放槽位
+
+		ymodem_ack_flush();
 	}
 
-	// 清空缓冲区
-	p->len = 0;
+	// 窗口模式下要等在途数据包收齐后才能擦除，缓冲池处理完后也要检查
+	ymodem_ack_flush();
+
+	// 等待波特率测试帧超时：退回默认波特率，按原速率继续传输
+	if (ymodem_baud_wait && pkt_pool.tail == pkt_pool.head)
+	{
+		SysTick_Delay_Ms(1);
+		if (--ymodem_baud_wait == 0)
+		{
+			ymodem_set_baudrate(DEBUG_USART_BAUDRATE);
+			ymodem_handshake();
+		}
+	}
 }
 
 // YMODEM初始化
@@ -224,17 +1670,126 @@ void ymodem_init(void)
 {
 	USART_Config();
 	timer_init();
-	queue_initiate(&rx_queue);
 	ymodem_status = 0;
+	frame_expect = 0;
 }
 
 // ==== 新增：重置Ymodem接收状态 ====
 void ymodem_reset(void)
 {
+	ymodem_set_baudrate(DEBUG_USART_BAUDRATE);
+
+	// 分帧、包池和广播状态由中断读写，关中断一次性清除
+	__disable_irq();
 	ymodem_status = 0;
 	g_ymodem_success = 0;
 	g_ymodem_byte_count = 0;
-	queue_initiate(&rx_queue); // 清空接收队列
+	frame_expect = 0;
+	ymodem_ack_pending = 0;
+	ymodem_window = 0;
+	ymodem_block = 0;
+	rx_present = 0;
+	ymodem_baud_wait = 0;
+	ymodem_journal = 0; // Flash中的记录保留，重新握手后可续传
+	ymodem_pages = 0;
+	ymodem_sparse = 0;
+	ymodem_bcast = 0;
+	ymodem_bcast_map = 0;
+	pkt_pool.tail = pkt_pool.head; // 丢弃未处理的数据包
+	ymodem_abort = 0;
+	__enable_irq();
+}
+
+/**
+ * @brief  设置多机总线节点号
+ * @param  node_id: 配置区中的节点号，YMODEM_NODE_P2P=点对点
+ * @retval None
+ * @note   总线上的节点在被SELECT之前不发送任何数据（包括握手字符）
+ */
+void ymodem_set_node_id(uint8_t node_id)
+{
+	ymodem_node_id = node_id;
+	ymodem_node_state = (node_id == YMODEM_NODE_P2P) ? NODE_SELECTED : NODE_IDLE;
+}
+
+/**
+ * @brief  广播会话结束后上报固件校验结果
+ * @param  ok: 1=校验通过 0=校验失败
+ * @retval None
+ * @note   结果作为接收状态在下一次POLL应答中发出（校验期间到达的POLL也按结果应答），
+ *         应答后或超时后返回；点对点和单节点会话已有结束应答，直接返回
+ */
+void ymodem_bcast_confirm(uint8_t ok)
+{
+	uint16_t wait = YMODEM_BCAST_CONFIRM_TIMEOUT;
+
+	if (!ymodem_bcast)
+	{
+		return;
+	}
+
+	ymodem_status = ok ? YMODEM_BCAST_VERIFIED : YMODEM_BCAST_REJECTED;
+	ymodem_reported = 0;
+	while (!ymodem_reported && wait > 0)
+	{
+		ymodem_process();
+		SysTick_Delay_Ms(1);
+		wait--;
+	}
+}
+
+/**
+ * @brief  取接收过程中累计的固件CRC32
+ * @param  length: 固件大小（固件头之后的部分）
+ * @param  crc: CRC32校验值（输出）
+ * @retval 1=累计范围恰好覆盖整个固件 0=无法使用（如广播会话），须从Flash重新计算
+ * @note   写入的每段数据都已回读比对，累计值与从Flash计算的结果相同
+ */
+uint8_t ymodem_get_crc32(uint32_t length, uint32_t *crc)
+{
+	if (ymodem_crc_addr == 0 || ymodem_crc_addr != g_ymodem_target_addr + sizeof(firmware_info_t) + length)
+	{
+		return 0;
+	}
+	*crc = crc32_final(&ymodem_crc);
+	return 1;
+}
+
+#if CRC32_USE_HW
+/**
+ * @brief  取接收过程中累计的硬件原生CRC，写入配置供之后启动时DMA校验
+ * @param  length: 固件大小（固件头之后的部分）
+ * @param  crc: 硬件原生CRC（输出），与crc32_hw_start对整个固件的计算结果相同
+ * @retval 1=累计范围恰好覆盖整个固件 0=无法使用，须从Flash重新计算
+ */
+uint8_t ymodem_get_hw_crc(uint32_t length, uint32_t *crc)
+{
+	crc32_ctx_t ctx = ymodem_hw_crc;
+
+	if (ymodem_crc_addr == 0 || ymodem_crc_addr != g_ymodem_target_addr + sizeof(firmware_info_t) + length)
+	{
+		return 0;
+	}
+	// 固件末尾不足一个字：DMA读取的整字包含其后Flash中的字节，这里同样从Flash取整字
+	if (ymodem_hw_crc_addr != ymodem_crc_addr)
+	{
+		crc32_native_update(&ctx, (const uint8_t *)ymodem_hw_crc_addr, 1);
+	}
+	*crc = crc32_native_final(&ctx);
+	return 1;
+}
+#endif
+
+/**
+ * @brief  开始一次接收：按编译配置发送握手字符
+ * @param  None
+ * @retval None
+ * @note   YMODEM_G_ENABLE=1时发送'G'请求流式传输，否则发送'C'
+ */
+void ymodem_start(void)
+{
+	ymodem_stream = YMODEM_G_ENABLE;
+	ymodem_handshake();
 }
 
 // 定时器初始化
@@ -245,9 +1800,9 @@ void timer_init(void)
 
 	RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM3, ENABLE); // 时钟使能
 
-	// 定时器TIM3初始化 (20ms定时 - 增加超时以适应115200波特率)
-	// 115200bps下133字节需要约11.5ms，20ms超时足够安全
-	TIM_TimeBaseStructure.TIM_Period = 1999;  // 自动重装载值 (改为20ms)
+	// 定时器TIM3初始化 (20ms字节间超时)
+	// 帧边界由帧长度判断，TIM3只在一帧接收中途断流时用于丢弃残帧
+	TIM_TimeBaseStructure.TIM_Period = 1999;  // 自动重装载值 (20ms)
 	TIM_TimeBaseStructure.TIM_Prescaler = 71; // 预分频值 72M/(71+1)=1MHz
 	TIM_TimeBaseStructure.TIM_ClockDivision = TIM_CKD_DIV1;
 	TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
@@ -255,9 +1810,9 @@ void timer_init(void)
 
 	TIM_ITConfig(TIM3, TIM_IT_Update, ENABLE); // 使能更新中断
 
-	// 中断优先级设置
+	// 中断优先级设置（与串口接收同抢占优先级，避免打断组帧过程）
 	NVIC_InitStructure.NVIC_IRQChannel = TIM3_IRQn;
-	NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
+	NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 3;
 	NVIC_InitStructure.NVIC_IRQChannelSubPriority = 1;
 	NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
 	NVIC_Init(&NVIC_InitStructure);
@@ -265,7 +1820,41 @@ void timer_init(void)
 	TIM_Cmd(TIM3, ENABLE); // 使能定时器
 }
 
-// USART1中断处理函数
+#if DEBUG_USART_RX_DMA
+// DMA接收数据回调：直接在DMA缓冲区中原地组帧
+void usart_rx_handler(const uint8_t *data, uint16_t len)
+{
+	ymodem_frame_input(data, len);
+
+	// 重置字节间超时定时器
+	TIM3->CNT = 0;
+	TIM_Cmd(TIM3, ENABLE);
+}
+
+// USART1中断处理函数（DMA模式下只处理空闲线路事件和发送）
+void USART1_IRQHandler(void)
+{
+	if (USART_GetITStatus(USART1, USART_IT_IDLE) != RESET)
+	{
+		// 读SR后读DR清除IDLE标志
+		USART_ReceiveData(USART1);
+		Usart_Rx_DMA_Poll();
+	}
+	Usart_Tx_IRQHandler();
+}
+
+// DMA1通道5中断处理函数 - 接收缓冲区半满/全满
+void DEBUG_USART_RX_DMA_IRQHandler(void)
+{
+	if (DMA_GetITStatus(DEBUG_USART_RX_DMA_IT_HT) != RESET ||
+		DMA_GetITStatus(DEBUG_USART_RX_DMA_IT_TC) != RESET)
+	{
+		DMA_ClearITPendingBit(DEBUG_USART_RX_DMA_IT_HT | DEBUG_USART_RX_DMA_IT_TC);
+		Usart_Rx_DMA_Poll();
+	}
+}
+#else
+// USART1中断处理函数：每收到一个字节随即组帧，完整的帧放入数据包缓冲池交给主循环
 void USART1_IRQHandler(void)
 {
 	uint8_t res;
@@ -273,39 +1862,44 @@ void USART1_IRQHandler(void)
 	if (USART_GetITStatus(USART1, USART_IT_RXNE) != RESET)
 	{
 		res = USART_ReceiveData(USART1);
-		queue_append(&rx_queue, res);
 		USART_ClearITPendingBit(USART1, USART_IT_RXNE);
-	}
+		ymodem_frame_input(&res, 1);
 
-	// 重置定时器计数，用于检测数据包边界
-	TIM3->CNT = 0;
-	TIM_Cmd(TIM3, ENABLE);
+		// 重置字节间超时定时器
+		TIM3->CNT = 0;
+		TIM_Cmd(TIM3, ENABLE);
+	}
+	Usart_Tx_IRQHandler();
 }
+#endif
 
-// TIM3中断处理函数 - 用于处理接收完一帧数据的情况
+// TIM3中断处理函数 - 字节间超时，丢弃不完整的帧
 void TIM3_IRQHandler(void)
 {
 	if (TIM_GetITStatus(TIM3, TIM_IT_Update) == SET)
 	{
-		int result = 1;
 		TIM_ClearITPendingBit(TIM3, TIM_IT_Update);
 		TIM_Cmd(TIM3, DISABLE);
 
-		// 处理队列中的数据
-		if (queue_not_empty(&rx_queue))
+		if (frame_expect != 0)
 		{
-			recvBuf.len = 0;
-			do
-			{
-				result = queue_delete(&rx_queue, &recvBuf.data[recvBuf.len]);
-				if (result == 1)
-				{
-					recvBuf.len++;
-				}
-			} while (result);
+			// 帧接收中途断流，丢弃残帧
+			frame_expect = 0;
 
-			// 调用YMODEM接收处理函数
-			ymodem_recv(&recvBuf);
+			// 数据阶段请求发送方重发当前包，流式模式直接取消；
+			// 广播会话不应答，缺失的包由发送方查询后补发
+			if (ymodem_stream && !ymodem_bcast)
+			{
+				ymodem_abort_transfer();
+			}
+			else if (ymodem_window)
+			{
+				ymodem_nack_seq(rx_expect_seq);
+			}
+			else if (ymodem_status == 1 && !ymodem_bcast)
+			{
+				ymodem_nack();
+			}
 		}
 	}
 }
@@ -4,36 +4,113 @@
 #include "stm32f10x_conf.h"
 #include <string.h>
 #include "bsp_usart.h"
+#include "crc32.h"
 
 // YMODEM协议常量定义
 #define YMODEM_SOH		0x01  // 开始128字节数据块
 #define YMODEM_STX		0x02  // 开始1024字节数据块
+#define YMODEM_BLK		0x03  // 开始协商大小的大数据块（非标准，仅在双方协商后使用）
 #define YMODEM_EOT		0x04  // 传输结束
 #define YMODEM_ACK		0x06  // 肯定应答
 #define YMODEM_NAK		0x15  // 否定应答
 #define YMODEM_CA		0x18  // 取消传输
 #define YMODEM_C		0x43  // 控制字符'C'
+#define YMODEM_G		0x47  // 控制字符'G'请求YMODEM-G流式传输
+#define YMODEM_EXT		0x05  // 扩展命令帧（非标准，仅在双方协商后使用）
+
+// 扩展命令帧格式：EXT + CMD + LEN(2字节小端) + 数据 + CRC16(CMD..数据，高字节在前)
+#define YMODEM_EXT_OVERHEAD     6
+#define YMODEM_EXT_OPTIONS      0x01  // 起始帧选项应答，数据为"key=value"文本
+#define YMODEM_EXT_PING         0x02  // 波特率切换后的测试帧，接收方原样回送
+#define YMODEM_EXT_PAGE_CRC     0x03  // 接收方上报目标分区和运行分区的逐页CRC32
+#define YMODEM_EXT_PAGE_MAP     0x04  // 发送方下发逐页处理方式，接收方应答1字节结果（1=成功）
+
+// 差异页传输：起始帧选项"pages=1"请求，接收方应答"pages=N"（文件覆盖的页数，0=不支持）后
+// 紧接着发送PAGE_CRC帧：N个目标分区页CRC32 + N个运行分区页CRC32（小端，最后一页只算文件覆盖部分）。
+// 发送方比较后在第一个数据包之前下发PAGE_MAP帧（每页1字节），之后只按顺序发送SEND页的数据
+#define YMODEM_PAGE_SEND        0     // 内容有变化，需要传输
+#define YMODEM_PAGE_KEEP        1     // 与目标分区中的内容相同，保留
+#define YMODEM_PAGE_COPY        2     // 与运行分区中同一页相同，由接收方复制
+#define YMODEM_PAGE_ERASE       3     // 整页为0xFF，接收方只擦除
+
+// 多机总线（RS-485）寻址：节点号保存在配置区，YMODEM_NODE_P2P表示点对点连接，不做寻址。
+// 总线上的节点进入升级模式后保持静默：SELECT本节点号后按标准YMODEM会话；
+// SELECT广播地址后所有节点接收同一组数据包但都不应答，数据包按序号写入对应位置，
+// 发送方逐个节点POLL已收数据包位图，只补发缺失的包，收齐后广播EOT结束
+#define YMODEM_EXT_SELECT       0x05  // 选择会话节点，数据为节点号（1字节）
+#define YMODEM_EXT_POLL         0x06  // 查询节点，数据为节点号；节点应答节点号+接收状态+已收数据包位图(4字节小端)
+// 擦除区跳过：原始固件包中整段的0xFF不传输，发送方在数据包之间发送SKIP帧，
+// 接收方擦除该段覆盖的页后直接移动写指针（擦除后的Flash读出即为0xFF）。
+// 偏移须等于当前写入位置，应答丢失后重发的SKIP帧只补发应答；接收方拒绝（应答0）时发送方改为正常发送该段
+#define YMODEM_EXT_SKIP         0x07  // 数据为文件偏移+跳过长度（各4字节小端），接收方应答1字节结果（1=成功）
+
+#define YMODEM_NODE_P2P         0x00  // 点对点（默认）
+#define YMODEM_NODE_BROADCAST   0xFF  // 广播地址
+#define YMODEM_BCAST_MAX_PACKETS 32   // 广播会话最多数据包数（位图宽度，1024字节数据包）
+// 广播会话中节点不发结束应答：收到EOT后校验固件，把结果作为接收状态在下一次POLL应答中上报后才跳转，
+// 发送方只把上报校验通过的节点计为升级完成
+#define YMODEM_BCAST_VERIFIED   0x10  // POLL应答接收状态：固件校验通过
+#define YMODEM_BCAST_REJECTED   0x11  // POLL应答接收状态：固件校验失败
+#define YMODEM_BCAST_CONFIRM_TIMEOUT 2000 // 等待发送方查询校验结果的超时时间(ms)
+
+// 波特率协商：起始帧选项"baud=N"给出发送方支持的最高波特率，
+// 双方切换到共同支持的最高档后用测试帧确认，超时未确认则退回默认波特率
+#define YMODEM_BAUD_TEST_LEN     64   // 测试帧数据长度
+#define YMODEM_BAUD_TEST_TIMEOUT 1000 // 等待测试帧超时时间(ms)
 #define YMODEM_END      0x4F  // 控制字符'O'关闭传输
 
-// 队列相关定义
-#define MAX_QUEUE_SIZE  1200
+// 大数据块：起始帧选项"blk=N"请求N字节的数据包，接收方应答不超过YMODEM_BLOCK_MAX的页大小整数倍
+// （0=不支持），之后数据包可用BLK帧头发送，每包写满整页，帧头、CRC和应答往返的开销摊薄到4~8页。
+// 缓冲池槽位按最大帧分配，加大后槽位减少，需按链路取舍：
+//   1024（默认）：4槽，支持滑动窗口（最大3）和YMODEM-G，不接受大数据块
+//   4096：2槽，没有窗口，每包仍要等应答；YMODEM-G下一包写4页期间只能再缓存一包，
+//         高波特率时必然溢出，因此流式模式下不协商大数据块。只适合停等模式下的长线低速链路
+//   8192：1槽，写完Flash才应答，不再流水线
+#define YMODEM_BLOCK_MAX 1024 // 须为页大小（1KB）的整数倍，不超过8192
 
-// 顺序循环队列的结构体定义
-typedef struct
-{
-	uint8_t queue[MAX_QUEUE_SIZE];
-	int rear;  //队尾指针
-	int front;  //队头指针
-	int count;  //计数器
-} seq_queue_t;
+// YMODEM-G流式传输：1=握手发送'G'，数据包不逐包应答，任何错误直接取消传输。
+// 只有首包（固件头）在校验通过并擦除全部覆盖页后应答一次，发送方收到后连续发送其余数据包
+// 仅适用于无差错链路（USB-CDC、短线缆），完整性由固件CRC32兜底；0=标准YMODEM
+#define YMODEM_G_ENABLE 0
+
+// 帧长度定义（帧头1 + 序号2 + 数据 + CRC16 2）
+#define YMODEM_FRAME_OVERHEAD   5
+#define YMODEM_SOH_FRAME_LEN    (128 + YMODEM_FRAME_OVERHEAD)   // 133字节
+#define YMODEM_STX_FRAME_LEN    (1024 + YMODEM_FRAME_OVERHEAD)  // 1029字节
+#define YMODEM_FRAME_MAX_LEN    (YMODEM_BLOCK_MAX + YMODEM_FRAME_OVERHEAD)
 
-// 下载缓冲区结构体
+// 下载缓冲区结构体：帧头和序号共3字节，len和填充字节放在data之前，
+// 使数据区（data[3]起）半字对齐，写Flash时直接按半字读取
 typedef struct
 {
-	uint8_t data[1200];
 	uint16_t len;
+	uint8_t reserved;
+	uint8_t data[YMODEM_FRAME_MAX_LEN];
 } download_buf_t;
 
+// 数据包缓冲池：中断组帧并校验CRC后入池立即应答，主循环取出写Flash
+// 流水线：第N包写Flash的同时接收后续数据包。槽位数随最大帧长减少，缓冲池总大小不超过约8KB
+// （1KB数据包4槽约4.1KB，4KB数据包2槽约8.2KB，8KB数据包1槽不再流水线），适配20KB SRAM
+#if YMODEM_BLOCK_MAX > 4096
+#define YMODEM_PKT_POOL_SIZE  1
+#elif YMODEM_BLOCK_MAX > 1024
+#define YMODEM_PKT_POOL_SIZE  2
+#else
+#define YMODEM_PKT_POOL_SIZE  4   // 必须为2的幂，且不超过8
+#endif
+
+// 滑动窗口：起始帧选项"win=N"协商，发送方最多N包在途，
+// 接收方累计应答ACK+序号，NAK+序号请求单包重发。需留一个槽位给正在写Flash的数据包，
+// 少于3个槽位时不支持窗口模式
+#define YMODEM_WINDOW_MAX     (YMODEM_PKT_POOL_SIZE - 1)
+
+typedef struct
+{
+	download_buf_t pkt[YMODEM_PKT_POOL_SIZE];
+	volatile uint8_t head;  // 写入计数（仅中断修改）
+	volatile uint8_t tail;  // 读出计数（仅主循环修改）
+} ymodem_pkt_pool_t;
+
 // ==== 新增：Ymodem接收结果结构体 ====
 typedef struct
 {
@@ -43,8 +120,7 @@ typedef struct
 } ymodem_result_t;
 
 // 全局变量声明
-extern seq_queue_t rx_queue;
-extern download_buf_t recvBuf;
+extern ymodem_pkt_pool_t pkt_pool;
 extern volatile uint8_t g_ymodem_success;
 extern uint8_t type;
 // ==== 新增：设置Ymodem写入的目标地址 ====
@@ -52,21 +128,25 @@ extern uint32_t g_ymodem_target_addr;
 extern uint32_t g_ymodem_file_size;
 // YMODEM协议相关函数
 extern void ymodem_c(void);       // 发送'C'字符开始接收
+void ymodem_start(void);          // 发送握手字符开始接收（'C'或'G'）
 extern uint8_t ymodem_c_ex(uint32_t target_addr, ymodem_result_t *result);  // 新增：增强版，返回结果
 //extern uint32_t g_ymodem_file_size;
 void ymodem_init(void);           // 初始化YMODEM协议
 void ymodem_reset(void);          // 重置YMODEM接收状态
-
-// 队列操作函数
-void queue_initiate(seq_queue_t *Q);
-int queue_not_empty(seq_queue_t *Q);
-int queue_delete(seq_queue_t *Q, uint8_t *d);
-int queue_append(seq_queue_t *Q, uint8_t x);
+void ymodem_process(void);        // 主循环调用：处理已接收的数据包
+void ymodem_set_node_id(uint8_t node_id); // 设置多机总线节点号（ymodem_start之前调用）
+void ymodem_bcast_confirm(uint8_t ok);    // 广播会话：在POLL应答中上报固件校验结果
+uint8_t ymodem_get_crc32(uint32_t length, uint32_t *crc); // 取接收过程中累计的固件CRC32
+#if CRC32_USE_HW
+uint8_t ymodem_get_hw_crc(uint32_t length, uint32_t *crc); // 取接收过程中累计的硬件原生CRC
+#endif
 
 // YMODEM控制函数
 void ymodem_ack(void);
 void ymodem_nack(void);
 void ymodem_end(void);
+void ymodem_cancel(void);
+void ymodem_g(void);
 
 // 定时器初始化
 void timer_init(void);
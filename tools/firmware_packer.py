@@ -12,6 +12,8 @@
 
 示例：
     python firmware_packer.py app.bin 1.0.0 app_v1.0.0.bin -打包固件
+    python firmware_packer.py pack app.bin 1.0.0 app_v1.0.0.bin -z -打包并压缩固件
+    python firmware_packer.py delta app_v1.0.0.bin app.bin 1.0.1 app_v1.0.1_delta.bin -生成差分包
     python firmware_packer.py info app_v1.0.0.bin -查看固件包信息
 """
 
@@ -26,11 +28,126 @@ class FirmwarePacker:
         self.MAGIC = 0x5AA5F00F
         self.VALID_FLAG = 0xAA
 
+        # 固件包标志（头部reserved1字段）
+        self.FLAG_COMPRESSED = 0x01
+        self.FLAG_DELTA = 0x02
+
+        # LZ压缩参数（与Boot/IAP/Decompress/lz_stream.h一致）
+        self.LZ_MIN_MATCH = 4
+        self.LZ_MAX_OFFSET = 0xFFFF
+        self.LZ_SEARCH_DEPTH = 32   # 每个位置最多比较的候选数
+
     def calculate_crc32(self, data):
         """计算CRC32校验值（与STM32端算法一致）"""
         return binascii.crc32(data) & 0xFFFFFFFF
 
-    def pack_firmware(self, bin_file, version, output_file):
+    @staticmethod
+    def _lz_length(out, length):
+        """写入长度扩展字节：逐个写255，最后写余数"""
+        while length >= 255:
+            out.append(255)
+            length -= 255
+        out.append(length)
+
+    def _lz_sequence(self, out, literals, offset=0, match_len=0):
+        """写入一个序列：令牌 + 字面量 + 偏移 + 匹配长度扩展（match_len=0为末尾纯字面量序列）"""
+        lit_len = len(literals)
+        ml = match_len - self.LZ_MIN_MATCH if match_len else 0
+        out.append((min(lit_len, 15) << 4) | min(ml, 15))
+        if lit_len >= 15:
+            self._lz_length(out, lit_len - 15)
+        out += literals
+        if match_len:
+            out += struct.pack('<H', offset)
+            if ml >= 15:
+                self._lz_length(out, ml - 15)
+
+    def lz_compress(self, data, dictionary=b''):
+        """
+        LZ压缩（LZ4块格式，贪心匹配）
+
+        设备端按流式解压，匹配源直接读取已写入Flash的输出，
+        因此窗口只受16位偏移限制，对20KB分区即整个镜像。
+        dictionary为差分升级的旧固件，视为紧接在数据之前，匹配可以引用其中的内容
+        """
+        out = bytearray()
+        data = bytes(dictionary) + bytes(data)
+        n = len(data)
+        chains = {}     # 4字节前缀 -> 出现位置列表
+        anchor = len(dictionary)    # 尚未输出的字面量起点
+        i = anchor
+
+        def insert(pos):
+            if pos + self.LZ_MIN_MATCH <= n:
+                chains.setdefault(data[pos:pos + self.LZ_MIN_MATCH], []).append(pos)
+
+        for pos in range(len(dictionary)):
+            insert(pos)
+
+        while i + self.LZ_MIN_MATCH <= n:
+            best_len = 0
+            best_off = 0
+            for cand in reversed(chains.get(data[i:i + self.LZ_MIN_MATCH], [])[-self.LZ_SEARCH_DEPTH:]):
+                offset = i - cand
+                if offset > self.LZ_MAX_OFFSET:
+                    break
+                length = self.LZ_MIN_MATCH
+                while i + length < n and data[cand + length] == data[i + length]:
+                    length += 1
+                if length > best_len:
+                    best_len, best_off = length, offset
+
+            if best_len >= self.LZ_MIN_MATCH:
+                self._lz_sequence(out, data[anchor:i], best_off, best_len)
+                for pos in range(i, i + best_len):
+                    insert(pos)
+                i += best_len
+                anchor = i
+            else:
+                insert(i)
+                i += 1
+
+        # 末尾剩余字面量；若数据正好以匹配结束则不需要
+        if anchor < n:
+            self._lz_sequence(out, data[anchor:])
+
+        return bytes(out)
+
+    def lz_decompress(self, data, size, dictionary=b''):
+        """LZ解压（与设备端lz_stream.c逻辑一致），用于打包后自检"""
+        out = bytearray(dictionary)
+        size += len(dictionary)
+        i = 0
+        while len(out) < size:
+            token = data[i]
+            i += 1
+            lit_len = token >> 4
+            if lit_len == 15:
+                while True:
+                    lit_len += data[i]
+                    i += 1
+                    if data[i - 1] != 255:
+                        break
+            out += data[i:i + lit_len]
+            i += lit_len
+            if len(out) >= size:
+                break
+            offset = struct.unpack('<H', data[i:i + 2])[0]
+            i += 2
+            match_len = (token & 0x0F) + self.LZ_MIN_MATCH
+            if match_len - self.LZ_MIN_MATCH == 15:
+                while True:
+                    match_len += data[i]
+                    i += 1
+                    if data[i - 1] != 255:
+                        break
+            if offset == 0 or offset > len(out):
+                raise ValueError("匹配偏移超出范围")
+            for _ in range(match_len):
+                out.append(out[-offset])
+        return bytes(out[len(dictionary):size])
+
+    def pack_firmware(self, bin_file, version, output_file, compress=False, flags=0, payload=None):
         """
         打包固件
 
@@ -38,6 +155,9 @@ class FirmwarePacker:
             bin_file: 输入的原始bin文件路径
             version: 版本号字符串，格式："major.minor.patch" 如 "1.0.0"
             output_file: 输出的打包固件文件路径
+            compress: 是否压缩固件数据（头部CRC32仍按解压后的固件计算）
+            flags: 固件包标志（差分包由pack_delta传入）
+            payload: 头部之后的数据（差分包由pack_delta传入），默认为固件数据
         """
         # 检查输入文件是否存在
         if not os.path.exists(bin_file):
@@ -83,6 +203,17 @@ class FirmwarePacker:
 
         print(f"固件版本: {ver_major}.{ver_minor}.{ver_patch}")
 
+        # 压缩固件数据
+        if payload is None:
+            payload = firmware_data
+        if compress:
+            payload = self.lz_compress(firmware_data)
+            if self.lz_decompress(payload, firmware_size) != firmware_data:
+                print("错误：压缩数据自检失败")
+                return False
+            flags |= self.FLAG_COMPRESSED
+            print(f"压缩后大小: {len(payload)} 字节 (压缩率 {len(payload) * 100 / max(firmware_size, 1):.1f}%)")
+
         # 获取时间戳（Unix时间戳）
         timestamp = int(datetime.now().timestamp())
         print(f"编译时间戳: {timestamp} ({datetime.fromtimestamp(timestamp).strftime('%Y-%m-%d %H:%M:%S')})")
@@ -95,7 +226,7 @@ class FirmwarePacker:
                             ver_major,
                             ver_minor,
                             ver_patch,
-                            0)  # reserved1
+                            flags)  # reserved1: 固件包标志
         header += struct.pack('<I',     # firmware_size
                             firmware_size)
         header += struct.pack('<I',     # firmware_crc32
@@ -115,7 +246,7 @@ class FirmwarePacker:
         print(f"\n正在生成固件包: {output_file}")
         with open(output_file, 'wb') as f:
             f.write(header)
-            f.write(firmware_data)
+            f.write(payload)
 
         output_size = os.path.getsize(output_file)
         print(f"\n固件包生成完成！")
@@ -123,12 +254,67 @@ class FirmwarePacker:
         print(f"  总大小: {output_size} 字节 ({output_size/1024:.2f} KB)")
         print(f"  头部: 24 字节")
         print(f"  固件: {firmware_size} 字节")
+        if payload is not firmware_data:
+            print(f"  {'差分' if flags & self.FLAG_DELTA else '压缩'}数据: {len(payload)} 字节")
         print(f"  版本: v{ver_major}.{ver_minor}.{ver_patch}")
         print(f"  CRC32: 0x{firmware_crc:08X}")
         print(f"\n请使用 UpdateUI.py 发送此固件包到设备")
 
         return True
 
+    def read_base_image(self, base_file):
+        """读取基准固件：可以是固件包（去掉头部）或原始bin文件"""
+        with open(base_file, 'rb') as f:
+            data = f.read()
+        if len(data) >= 24 and struct.unpack('<I', data[0:4])[0] == self.MAGIC:
+            flags = data[7]
+            if flags & (self.FLAG_COMPRESSED | self.FLAG_DELTA):
+                raise ValueError("基准固件不能是压缩包或差分包")
+            size = struct.unpack('<I', data[8:12])[0]
+            return data[24:24 + size]
+        return data
+
+    def pack_delta(self, base_file, bin_file, version, output_file):
+        """
+        生成差分固件包
+
+        参数：
+            base_file: 设备当前运行的固件（固件包或原始bin）
+            bin_file: 新固件的原始bin文件
+            version: 新固件版本号
+            output_file: 输出的差分包路径
+
+        格式：固件头(24B，reserved1=FLAG_DELTA) + 基准CRC32(4B) + 基准大小(4B) + LZ数据
+        设备以运行分区中的旧固件为字典解压，写入另一个分区
+        """
+        for path in (base_file, bin_file):
+            if not os.path.exists(path):
+                print(f"错误：输入文件不存在 - {path}")
+                return False
+
+        try:
+            base_data = self.read_base_image(base_file)
+        except ValueError as e:
+            print(f"错误：{e}")
+            return False
+
+        with open(bin_file, 'rb') as f:
+            firmware_data = f.read()
+
+        delta = self.lz_compress(firmware_data, base_data)
+        if self.lz_decompress(delta, len(firmware_data), base_data) != firmware_data:
+            print("错误：差分数据自检失败")
+            return False
+
+        base_crc = self.calculate_crc32(base_data)
+        print(f"\n基准固件: {len(base_data)} 字节, CRC32: 0x{base_crc:08X}")
+        print(f"新固件: {len(firmware_data)} 字节")
+        print(f"差分数据: {len(delta)} 字节 ({len(delta) * 100 / max(len(firmware_data), 1):.1f}%)")
+
+        extension = struct.pack('<II', base_crc, len(base_data))
+        return self.pack_firmware(bin_file, version, output_file,
+                                  flags=self.FLAG_DELTA, payload=extension + delta)
+
     def unpack_firmware(self, packed_file):
         """
         解析固件包，显示固件信息
@@ -171,6 +357,11 @@ class FirmwarePacker:
         print(f"  CRC32: 0x{firmware_crc32:08X}")
         print(f"  编译时间: {datetime.fromtimestamp(build_timestamp).strftime('%Y-%m-%d %H:%M:%S')}")
         print(f"  有效标志: 0x{is_valid:02X} {'(有效)' if is_valid == self.VALID_FLAG else '(无效)'}")
+        if reserved1 & self.FLAG_DELTA:
+            base_crc, base_size = struct.unpack('<II', open(packed_file, 'rb').read()[24:32])
+            print(f"  数据格式: 差分包（基准固件 {base_size} 字节, CRC32: 0x{base_crc:08X}）")
+        else:
+            print(f"  数据格式: {'LZ压缩' if reserved1 & self.FLAG_COMPRESSED else '原始'}")
         print(f"  总大小: {os.path.getsize(packed_file)} 字节")
 
         return True
@@ -179,7 +370,10 @@ def print_usage():
     print("\n固件打包工具")
     print("=" * 50)
     print("\n用法1 - 打包固件：")
-    print("  python firmware_packer.py pack <输入.bin> <版本号> <输出.bin>")
+    print("  python firmware_packer.py pack <输入.bin> <版本号> <输出.bin> [-z]")
+    print("  -z: 压缩固件数据，设备接收时解压写入分区")
+    print("\n用法3 - 生成差分包（基准为设备当前运行的固件包或bin）：")
+    print("  python firmware_packer.py delta <基准固件> <新固件.bin> <版本号> <输出.bin>")
     print("\n用法2 - 查看固件信息：")
     print("  python firmware_packer.py info <固件包.bin>")
     print("\n示例：")
@@ -205,7 +399,8 @@ def main():
 
     if command == 'pack':
         # 打包模式
-        if len(sys.argv) != 5:
+        compress = len(sys.argv) == 6 and sys.argv[5] in ('-z', '--compress')
+        if len(sys.argv) != 5 and not compress:
             print("错误：参数数量不正确")
             print_usage()
             sys.exit(1)
@@ -214,7 +409,17 @@ def main():
         version = sys.argv[3]
         output_file = sys.argv[4]
 
-        success = packer.pack_firmware(input_file, version, output_file)
+        success = packer.pack_firmware(input_file, version, output_file, compress)
+        sys.exit(0 if success else 1)
+
+    elif command == 'delta':
+        # 差分包模式
+        if len(sys.argv) != 6:
+            print("错误：参数数量不正确")
+            print_usage()
+            sys.exit(1)
+
+        success = packer.pack_delta(sys.argv[2], sys.argv[3], sys.argv[4], sys.argv[5])
         sys.exit(0 if success else 1)
 
     elif command == 'info':
@@ -1,6 +1,9 @@
 import serial
 import time
+import binascii
+import io
 import os
+import struct
 import tkinter as tk
 from tkinter import ttk, filedialog, messagebox
 import threading
@@ -14,11 +17,84 @@ class SimpleYModemSender:
         # Ymodem协议定义
         self.SOH = 0x01
         self.STX = 0x02
+        self.BLK = 0x03    # 协商大小的大数据块（非标准，设备应答"blk=N"后使用）
         self.EOT = 0x04
         self.ACK = 0x06
         self.NAK = 0x15
         self.CA = 0x18
         self.CRC16 = 0x43  # 'C'
+        self.G = 0x47      # 'G' YMODEM-G流式传输
+        self.EXT = 0x05    # 扩展命令帧（设备对起始帧选项的应答等）
+
+        # 扩展命令字
+        self.EXT_OPTIONS = 0x01
+        self.EXT_PING = 0x02      # 波特率切换后的测试帧
+        self.EXT_PAGE_CRC = 0x03  # 设备上报两个分区的逐页CRC32
+        self.EXT_PAGE_MAP = 0x04  # 下发逐页处理方式
+        self.EXT_SELECT = 0x05    # 多机总线：选择会话节点
+        self.EXT_POLL = 0x06      # 多机总线：查询节点接收状态
+        self.EXT_SKIP = 0x07      # 跳过一段0xFF，设备擦除后直接移动写指针
+        self.NODE_BROADCAST = 0xFF
+        self.BCAST_MAX_PACKETS = 32
+        self.BCAST_VERIFIED = 0x10  # 查询应答接收状态：节点固件校验通过
+        self.BCAST_REJECTED = 0x11  # 查询应答接收状态：节点固件校验失败
+        self.BAUD_TEST_LEN = 64
+
+        self.FIRMWARE_MAGIC = 0x5AA5F00F   # 固件包头魔术字
+
+        # 页计划中每页的处理方式（与设备端YMODEM_PAGE_xxx一致）
+        self.PAGE_SIZE = 1024
+        self.PAGE_SEND = 0        # 内容有变化，需要传输
+        self.PAGE_KEEP = 1        # 与目标分区中的内容相同
+        self.PAGE_COPY = 2        # 与运行分区中同一页相同，设备复制
+        self.PAGE_ERASE = 3       # 整页为0xFF，设备只擦除
+
+        # 设备握手字符：'C'=标准YMODEM，'G'=YMODEM-G（不逐包应答）
+        self.handshake = self.CRC16
+
+        # 请求的滑动窗口大小（0=不协商，逐包停等）；实际窗口以设备应答为准
+        self.request_window = 8
+        self.window = 0
+        self.window_timeout = 3
+
+        # 请求的大数据块大小（0=不协商，最大1024字节的STX包）；实际大小以设备应答为准。
+        # 每包写满整页，帧头、CRC和应答往返的开销减少到1/4，高波特率下效果明显
+        self.request_block = 4096
+        self.block = 0
+
+        # 逐包应答模式：单个数据包最多发送次数（NAK或应答超时都会重发）
+        self.max_retries = 10
+        self.ack_timeout = 3
+
+        # 握手后协商的最高波特率（0=不切换）；设备在不超过该值的档位中选最高的
+        self.max_baudrate = 2000000
+        self.base_baudrate = 115200
+
+        # 断点续传：起始帧带文件标识（整个文件的CRC32），设备应答已写入的字节数，
+        # 从该处继续发送；YMODEM-G模式设备不支持续传
+        self.resume = True
+        self.resume_offset = 0
+
+        # 差异页传输：比较设备两个分区的逐页CRC32，只发送变化的页（仅原始固件包）；
+        # 设备执行页计划时要擦除和复制，等待应答的时间需覆盖整个分区
+        self.page_diff = True
+        self.page_crcs = None
+        self.page_map_timeout = 5
+
+        # 擦除区跳过：原始固件包中按128字节对齐、不短于skip_min的整段0xFF不传输，
+        # 改发SKIP帧由设备擦除后跳过；设备擦除跳过的页期间等待应答
+        self.skip_erased = True
+        self.skip_min = 1024
+        self.skip_timeout = 2
+
+        # 下一个数据包的序号（分段发送时接续）
+        self.next_seq = 1
+
+        # 多机总线批量升级：节点收到起始帧后一次擦除全部页（每页约20ms），期间不能广播数据包；
+        # 每轮广播后逐个节点查询位图，只补发缺失的包
+        self.bcast_erase_time = 0.03
+        self.bcast_rounds = 5
+        self.poll_timeout = 0.5
 
     def open_serial(self, port, baudrate=115200):
         """初始化串口连接"""
@@ -29,6 +105,7 @@ class SimpleYModemSender:
                 timeout=1
             )
             time.sleep(2)  # 等待串口稳定
+            self.base_baudrate = baudrate
             self.is_cancelled = False
             return True
         except Exception as e:
@@ -59,17 +136,142 @@ class SimpleYModemSender:
         return None
 
     def calculate_crc(self, data):
-        """计算CRC16校验值"""
-        crc = 0x0000
-        for byte in data:
-            crc ^= byte << 8
-            for _ in range(8):
-                if crc & 0x8000:
-                    crc = (crc << 1) ^ 0x1021
-                else:
-                    crc <<= 1
-                crc &= 0xFFFF
-        return crc
+        """计算CRC16-XMODEM校验值（多项式0x1021，初值0，与设备端crc16_update一致）"""
+        return binascii.crc_hqx(bytes(data), 0)
+
+    def receive_ext(self, timeout=3):
+        """接收扩展命令帧剩余部分（EXT字节已读取），返回(命令字, 数据)，失败返回None"""
+        self.serial_port.timeout = timeout
+        head = self.serial_port.read(3)
+        if len(head) != 3:
+            return None
+        length = head[1] | (head[2] << 8)
+        body = self.serial_port.read(length + 2)
+        if len(body) != length + 2:
+            return None
+        payload = body[:length]
+        crc = (body[length] << 8) | body[length + 1]
+        if self.calculate_crc(head + payload) != crc:
+            return None
+        return head[0], payload
+
+    def build_ext(self, cmd, payload):
+        """构建扩展命令帧：EXT + CMD + LEN(小端) + 数据 + CRC16"""
+        body = bytes([cmd, len(payload) & 0xFF, len(payload) >> 8]) + bytes(payload)
+        crc = self.calculate_crc(body)
+        return bytes([self.EXT]) + body + bytes([(crc >> 8) & 0xFF, crc & 0xFF])
+
+    @staticmethod
+    def baud_pattern():
+        """波特率测试图案，与设备端ymodem_baud_pattern一致"""
+        return bytes(((i * 73) & 0xFF) ^ (0xFF if i & 1 else 0x55) for i in range(64))
+
+    def switch_baudrate(self, baudrate, log_callback=None):
+        """切换到设备接受的波特率并发送测试帧确认，失败退回默认波特率"""
+        self.serial_port.baudrate = baudrate
+        self.serial_port.reset_input_buffer()
+
+        pattern = self.baud_pattern()
+        self.send_data(self.build_ext(self.EXT_PING, pattern))
+
+        # 设备确认前会在超时后自行退回默认波特率，这里的等待必须比设备短
+        if self.receive_byte(0.5) == self.EXT:
+            ext = self.receive_ext(0.5)
+            if ext and ext[0] == self.EXT_PING and ext[1] == pattern:
+                if log_callback:
+                    log_callback(f"波特率已切换至 {baudrate}")
+                return True
+
+        self.serial_port.baudrate = self.base_baudrate
+        if log_callback:
+            log_callback(f"波特率 {baudrate} 测试失败，退回 {self.base_baudrate}")
+        return False
+
+    def receive_page_crcs(self, pages):
+        """接收设备上报的逐页CRC32，返回(目标分区列表, 运行分区列表)，失败返回None"""
+        if self.receive_byte(3) != self.EXT:
+            return None
+        ext = self.receive_ext()
+        if not ext or ext[0] != self.EXT_PAGE_CRC or len(ext[1]) != pages * 8:
+            return None
+        crcs = struct.unpack(f'<{pages * 2}I', ext[1])
+        return list(crcs[:pages]), list(crcs[pages:])
+
+    def plan_pages(self, data):
+        """逐页比较CRC32，返回(页计划, 需要发送的数据)"""
+        target, active = self.page_crcs
+        plan = bytearray()
+        payload = bytearray()
+        for i in range(len(target)):
+            page = data[i * self.PAGE_SIZE:(i + 1) * self.PAGE_SIZE]
+            crc = binascii.crc32(page) & 0xFFFFFFFF
+            if crc == target[i]:
+                plan.append(self.PAGE_KEEP)
+            elif page.count(0xFF) == len(page):
+                plan.append(self.PAGE_ERASE)
+            elif crc == active[i]:
+                plan.append(self.PAGE_COPY)
+            else:
+                plan.append(self.PAGE_SEND)
+                payload += page
+        return bytes(plan), bytes(payload)
+
+    def send_page_map(self, plan, log_callback=None):
+        """下发页计划，等待设备擦除和复制完成"""
+        for retry in range(3):
+            self.send_data(self.build_ext(self.EXT_PAGE_MAP, plan))
+            response = self.receive_byte(self.page_map_timeout)
+            if response == self.EXT:
+                ext = self.receive_ext()
+                if ext and ext[0] == self.EXT_PAGE_MAP:
+                    return ext[1] == b'\x01'
+            elif response == self.CA:
+                return False
+            if log_callback:
+                log_callback(f"页计划应答超时，重试 {retry + 1}/3")
+        return False
+
+    def find_erased_runs(self, data, start=0):
+        """查找data[start:]中按128字节对齐的整段0xFF，返回[(偏移, 长度)]，短于skip_min的不跳过"""
+        runs = []
+        run_start = None
+        for pos in range(start, len(data), 128):
+            chunk = data[pos:pos + 128]
+            if chunk.count(0xFF) == len(chunk):
+                if run_start is None:
+                    run_start = pos
+                continue
+            if run_start is not None and pos - run_start >= self.skip_min:
+                runs.append((run_start, pos - run_start))
+            run_start = None
+        if run_start is not None and len(data) - run_start >= self.skip_min:
+            runs.append((run_start, len(data) - run_start))
+        return runs
+
+    def send_skip(self, offset, length):
+        """发送SKIP帧跳过一段0xFF，返回True=已跳过，False=设备拒绝，None=无应答或设备取消"""
+        payload = struct.pack('<II', offset, length)
+        for retry in range(3):
+            # 应答丢失时重发，设备对已执行的SKIP帧只补发应答
+            self.send_data(self.build_ext(self.EXT_SKIP, payload))
+            response = self.receive_byte(self.skip_timeout)
+            if response == self.EXT:
+                ext = self.receive_ext()
+                if ext and ext[0] == self.EXT_SKIP:
+                    return ext[1] == b'\x01'
+            elif response == self.CA:
+                return None
+        return None
+
+    @staticmethod
+    def parse_options(payload):
+        """解析"key=value"选项文本"""
+        options = {}
+        for token in payload.decode('ascii', 'ignore').split():
+            key, _, value = token.partition('=')
+            if value.isdigit():
+                options[key] = int(value)
+        return options
 
     def wait_for_sync(self, timeout=10, log_callback=None):
         """等待设备同步信号"""
@@ -81,21 +283,24 @@ class SimpleYModemSender:
 
         while time.time() - start_time < timeout and not self.is_cancelled:
             byte_recv = self.receive_byte(1)
-            if byte_recv == self.CRC16:
+            if byte_recv in (self.CRC16, self.G):
+                self.handshake = byte_recv
                 sync_count += 1
                 if log_callback:
-                    log_callback(f"收到同步字符'C' (第{sync_count}次)")
+                    log_callback(f"收到同步字符'{chr(byte_recv)}' (第{sync_count}次)")
 
                 # 检查是否有连续同步信号
                 time.sleep(0.1)
                 additional_c = self.receive_byte(0.1)
-                if additional_c == self.CRC16:
+                if additional_c == byte_recv:
                     sync_count += 1
                     if log_callback:
-                        log_callback(f"收到额外同步字符'C' (共{sync_count}次)")
+                        log_callback(f"收到额外同步字符'{chr(byte_recv)}' (共{sync_count}次)")
 
                 if log_callback:
-                    log_callback(f"同步完成，共收到 {sync_count} 个'C'")
+                    log_callback(f"同步完成，共收到 {sync_count} 个'{chr(byte_recv)}'")
+                    if self.handshake == self.G:
+                        log_callback("设备请求YMODEM-G流式传输")
                 return True
 
             if log_callback and int(time.time() - start_time) % 3 == 0 and int(time.time() - start_time) > 0:
@@ -111,12 +316,8 @@ class SimpleYModemSender:
                 log_callback("等待同步超时")
         return False
 
-    def send_file_header(self, filename, file_size, log_callback=None):
-        """发送文件头信息包"""
-        if log_callback:
-            log_callback("第二阶段：准备文件头包...")
-
-        # 构建文件头数据包
+    def build_header_packet(self, filename, file_size, options=None):
+        """构建起始帧（文件名 + 文件大小 + 扩展选项）"""
         header = bytearray(133)  # 3字节头 + 128字节数据 + 2字节CRC
         header[0] = self.SOH
         header[1] = 0x00  # 包序号
@@ -126,9 +327,6 @@ class SimpleYModemSender:
         data_index = 3
         filename_bytes = filename.encode('ascii', 'ignore')
 
-        if log_callback:
-            log_callback(f"文件头信息 - 文件名: {filename}, 大小: {file_size} 字节")
-
         # 文件名填充
         for byte in filename_bytes:
             header[data_index] = byte
@@ -142,6 +340,14 @@ class SimpleYModemSender:
             header[data_index] = ord(char)
             data_index += 1
         header[data_index] = 0x00  # 大小结束符
+        data_index += 1
+
+        # 扩展选项（标准接收方忽略大小之后的内容）
+        if options:
+            option_bytes = ' '.join(f"{k}={v}" for k, v in options.items()).encode('ascii')
+            if data_index + len(option_bytes) < 131:
+                header[data_index:data_index + len(option_bytes)] = option_bytes
+                data_index += len(option_bytes)
 
         # 剩余空间补零
         while data_index < 131:
@@ -153,6 +359,26 @@ class SimpleYModemSender:
         header[131] = (crc >> 8) & 0xFF
         header[132] = crc & 0xFF
 
+        return header
+
+    def send_file_header(self, filename, file_size, log_callback=None, options=None):
+        """发送文件头信息包
+
+        options为扩展选项字典（如{'win': 8}），以"key=value"文本写在文件大小之后，
+        设备接受后在ACK与握手字符之间回复扩展命令帧
+        """
+        self.window = 0
+        self.block = 0
+        self.resume_offset = 0
+        self.page_crcs = None
+        if log_callback:
+            log_callback("第二阶段：准备文件头包...")
+
+        if log_callback:
+            log_callback(f"文件头信息 - 文件名: {filename}, 大小: {file_size} 字节")
+
+        header = self.build_header_packet(filename, file_size, options)
+
         if log_callback:
             log_callback("发送文件头包...")
 
@@ -171,12 +397,33 @@ class SimpleYModemSender:
 
                 # 等待数据传输启动信号
                 if log_callback:
-                    log_callback("等待第二个'C'启动数据包传输...")
+                    log_callback(f"等待第二个'{chr(self.handshake)}'启动数据包传输...")
 
                 second_c = self.receive_byte(3)
-                if second_c == self.CRC16:
+                if second_c == self.EXT:
+                    ext = self.receive_ext()
+                    if ext and ext[0] == self.EXT_OPTIONS:
+                        accepted = self.parse_options(ext[1])
+                        self.window = accepted.get('win', 0)
+                        self.block = accepted.get('blk', 0)
+                        if log_callback:
+                            log_callback(f"设备接受选项: {ext[1].decode('ascii', 'ignore')}")
+                        self.resume_offset = accepted.get('resume', 0)
+                        # 逐页CRC32紧跟选项应答，以默认波特率发送
+                        if accepted.get('pages', 0) > 0:
+                            self.page_crcs = self.receive_page_crcs(accepted['pages'])
+                            if self.page_crcs is None and log_callback:
+                                log_callback("逐页CRC32接收失败，传输整个文件")
+                        baudrate = accepted.get('baud', self.base_baudrate)
+                        if baudrate != self.base_baudrate:
+                            self.switch_baudrate(baudrate, log_callback)
+                    elif log_callback:
+                        log_callback("扩展应答帧无效，按标准模式传输")
+                    second_c = self.receive_byte(3)
+
+                if second_c == self.handshake:
                     if log_callback:
-                        log_callback("第二个'C'收到，文件头发送成功")
+                        log_callback(f"第二个'{chr(self.handshake)}'收到，文件头发送成功")
                     return True
                 else:
                     if log_callback:
@@ -195,19 +442,25 @@ class SimpleYModemSender:
             log_callback("文件头发送失败")
         return False
 
-    def send_data_packet(self, packet_num, data, log_callback=None):
-        """发送数据包"""
-        if self.is_cancelled:
-            return False
+    def chunk_size(self, remaining):
+        """按剩余字节数选择下一个数据包的大小：协商的大数据块、1024字节STX包，不足1024字节时用128字节SOH包"""
+        if self.block and remaining >= self.block:
+            return self.block
+        return 1024 if remaining >= 1024 else min(128, remaining)
 
+    def build_data_packet(self, packet_num, data, log_callback=None):
+        """构建数据包（帧头 + 序号 + 数据 + CRC16）"""
         packet_size = len(data)
-        is_1k = packet_size == 1024
 
         if log_callback:
             log_callback(f"发送数据包 {packet_num}, 大小: {packet_size} 字节")
 
         # 构建数据包
-        if is_1k:
+        if self.block and packet_size == self.block:
+            packet = bytearray(self.block + 5)  # BLK + 序号 + 取反 + 数据 + 2字节CRC
+            packet[0] = self.BLK
+            packet_size_to_send = self.block
+        elif packet_size == 1024:
             packet = bytearray(1029)  # STX + 序号 + 取反 + 1024数据 + 2字节CRC
             packet[0] = self.STX
             packet_size_to_send = 1024
@@ -232,13 +485,23 @@ class SimpleYModemSender:
         packet[3+packet_size_to_send] = (crc >> 8) & 0xFF
         packet[3+packet_size_to_send+1] = crc & 0xFF
 
+        return packet
+
+    def send_data_packet(self, packet_num, data, log_callback=None):
+        """发送数据包，返回True=已确认，False=需要重发
+
+        设备按序号校验，重发的数据包若已收到只会补发应答不会重复写入；
+        重发前清空接收缓冲区，避免上一次迟到的应答被当成本包的应答
+        """
+        if self.is_cancelled:
+            return False
+
         # 发送数据包
-        self.send_data(packet)
+        self.send_data(self.build_data_packet(packet_num, data, log_callback))
 
         # 等待确认
-        ack_retry = 0
-        while ack_retry < 3 and not self.is_cancelled:
-            ack = self.receive_byte(10)
+        while not self.is_cancelled:
+            ack = self.receive_byte(self.ack_timeout)
             if ack == self.ACK:
                 if log_callback:
                     log_callback(f"数据包 {packet_num} 发送成功")
@@ -246,20 +509,229 @@ class SimpleYModemSender:
             elif ack == self.NAK:
                 if log_callback:
                     log_callback(f"数据包 {packet_num} 被拒绝(NAK)，准备重发")
+                break
+            elif ack == self.CA:
+                if log_callback:
+                    log_callback(f"设备在数据包 {packet_num} 处取消了传输")
+                self.is_cancelled = True
                 return False
             elif ack is None:
-                ack_retry += 1
                 if log_callback:
-                    log_callback(f"数据包 {packet_num} ACK等待超时，重试 {ack_retry}/3")
+                    log_callback(f"数据包 {packet_num} ACK等待超时，准备重发")
+                break
             else:
                 if log_callback:
                     log_callback(f"数据包 {packet_num} 意外响应: 0x{ack:02X}")
-                ack_retry += 1
 
-        if log_callback:
-            log_callback(f"数据包 {packet_num} 发送失败")
+        self.serial_port.reset_input_buffer()
         return False
 
+    def send_data_acked(self, file, file_size, progress_callback=None, log_callback=None):
+        """标准YMODEM发送：逐包等待应答，NAK或超时重发"""
+        packet_num = self.next_seq
+        bytes_sent = 0
+
+        while not self.is_cancelled and bytes_sent < file_size:
+            # 根据剩余字节数决定读取大小
+            remaining = file_size - bytes_sent
+            data = file.read(self.chunk_size(remaining))
+
+            if not data:
+                break
+
+            bytes_sent += len(data)
+
+            # 进度更新
+            if progress_callback:
+                progress = min(100, int((bytes_sent / file_size) * 100))
+                progress_callback(progress, packet_num, bytes_sent, file_size)
+
+            if log_callback and packet_num % 10 == 0:
+                log_callback(f"传输进度: {progress}% ({bytes_sent}/{file_size} 字节)")
+
+            # 数据包发送：NAK或超时只重发这一包
+            success = False
+            for retry in range(self.max_retries):
+                if self.send_data_packet(packet_num, data, log_callback):
+                    success = True
+                    break
+                elif self.is_cancelled:
+                    break
+                else:
+                    if log_callback:
+                        log_callback(f"数据包 {packet_num} 第 {retry + 1} 次重试")
+
+            if not success:
+                return False, f"数据包 {packet_num} 发送失败"
+
+            packet_num += 1
+
+        self.next_seq = packet_num
+        return True, "数据发送完成"
+
+    def send_data_window(self, file, file_size, progress_callback=None, log_callback=None):
+        """滑动窗口发送：最多window包在途，设备累计应答ACK+序号，NAK+序号只重发该包"""
+        # 预先切分全部数据包，重发时按序号取回
+        chunks = []
+        remaining = file_size
+        while remaining > 0:
+            data = file.read(self.chunk_size(remaining))
+            if not data:
+                break
+            chunks.append(data)
+            remaining -= len(data)
+
+        first = self.next_seq  # 第一个数据包的序号
+        base = 0        # 最早未确认的数据包下标
+        next_idx = 0    # 下一个待发送的数据包下标
+        bytes_acked = 0
+        timeouts = 0
+
+        while base < len(chunks):
+            if self.is_cancelled:
+                return False, "传输被用户取消"
+
+            # 填满发送窗口
+            while next_idx < len(chunks) and next_idx - base < self.window:
+                self.send_data(self.build_data_packet(first + next_idx, chunks[next_idx]))
+                next_idx += 1
+
+            response = self.receive_byte(self.window_timeout)
+            if response is None:
+                # 应答超时：重发窗口前沿的数据包
+                timeouts += 1
+                if timeouts > 10:
+                    return False, f"数据包 {first + base} 应答超时"
+                if log_callback:
+                    log_callback(f"应答超时，重发数据包 {first + base}")
+                self.send_data(self.build_data_packet(first + base, chunks[base]))
+                continue
+
+            if response == self.CA:
+                if log_callback:
+                    log_callback("设备取消了传输")
+                return False, "设备取消了传输"
+
+            if response not in (self.ACK, self.NAK):
+                continue
+
+            seq = self.receive_byte(self.window_timeout)
+            if seq is None:
+                continue
+            # 8位序号换算为窗口内的数据包下标
+            offset = (seq - (first + base)) & 0xFF
+
+            if response == self.ACK:
+                # 累计应答：序号之前（含）的数据包全部确认
+                if offset < next_idx - base:
+                    for i in range(base, base + offset + 1):
+                        bytes_acked += len(chunks[i])
+                    base += offset + 1
+                    timeouts = 0
+                    if progress_callback:
+                        progress = min(100, int((bytes_acked / file_size) * 100))
+                        progress_callback(progress, base, bytes_acked, file_size)
+            else:
+                # 选择重发：只重发NAK指定的数据包
+                if offset < next_idx - base:
+                    idx = base + offset
+                    if log_callback:
+                        log_callback(f"数据包 {first + idx} 被拒绝(NAK)，单独重发")
+                    self.send_data(self.build_data_packet(first + idx, chunks[idx]))
+
+        self.next_seq = first + len(chunks)
+        return True, "数据发送完成"
+
+    def send_data_stream(self, file, file_size, progress_callback=None, log_callback=None):
+        """YMODEM-G流式发送：连续发送全部数据包，不等待逐包应答"""
+        packet_num = self.next_seq
+        bytes_sent = 0
+
+        while not self.is_cancelled and bytes_sent < file_size:
+            remaining = file_size - bytes_sent
+            data = file.read(self.chunk_size(remaining))
+            if not data:
+                break
+
+            self.send_data(self.build_data_packet(packet_num, data))
+            bytes_sent += len(data)
+
+            # 首包带固件头：设备校验固件头（差分包核对基准固件）并擦除全部覆盖页后才应答，
+            # 之后的数据包连续发送，设备不再停下来擦除
+            if packet_num == 1:
+                response = self.receive_byte(10)
+                if response != self.ACK:
+                    if log_callback:
+                        log_callback("设备未接受首包（固件头无效或擦除失败）")
+                    return False, "设备未接受首包"
+
+            # 流式模式下设备出错会直接发送CA取消传输
+            if self.serial_port.in_waiting:
+                response = self.receive_byte(0)
+                if response == self.CA:
+                    if log_callback:
+                        log_callback(f"设备在数据包 {packet_num} 处取消了传输")
+                    return False, "设备取消了传输"
+
+            if progress_callback:
+                progress = min(100, int((bytes_sent / file_size) * 100))
+                progress_callback(progress, packet_num, bytes_sent, file_size)
+
+            if log_callback and packet_num % 10 == 0:
+                log_callback(f"流式传输进度: {bytes_sent}/{file_size} 字节")
+
+            packet_num += 1
+
+        # 等待数据全部发出后再进入结束阶段
+        self.serial_port.flush()
+        self.next_seq = packet_num
+        return True, "数据发送完成"
+
+    def send_range(self, data, begin, end, sent_before, total, progress_callback=None, log_callback=None):
+        """按协商的传输模式发送data[begin:end]，数据包序号接续上一段，进度按整个文件折算"""
+        def range_progress(progress, packet_num, sent, size):
+            if progress_callback:
+                done = sent_before + sent
+                progress_callback(min(100, int(done * 100 / total)), packet_num, done, total)
+
+        with io.BytesIO(data[begin:end]) as file:
+            if self.handshake == self.G:
+                return self.send_data_stream(file, end - begin, range_progress, log_callback)
+            elif self.window > 1:
+                return self.send_data_window(file, end - begin, range_progress, log_callback)
+            return self.send_data_acked(file, end - begin, range_progress, log_callback)
+
+    def send_payload(self, data, start, runs, progress_callback=None, log_callback=None):
+        """发送data[start:]：runs中的整段0xFF用SKIP帧跳过，其余部分正常发送"""
+        total = len(data) - start
+        pos = start
+        self.next_seq = 1
+
+        for offset, length in runs + [(len(data), 0)]:
+            if offset > pos:
+                success, message = self.send_range(data, pos, offset, pos - start, total,
+                                                   progress_callback, log_callback)
+                if not success:
+                    return False, message
+                pos = offset
+            if length == 0:
+                continue
+
+            result = self.send_skip(offset, length)
+            if result is None:
+                return False, f"跳过区域 0x{offset:X} 无应答"
+            if not result:
+                # 设备拒绝跳过，该段并入下一段正常发送
+                if log_callback:
+                    log_callback(f"设备拒绝跳过区域 0x{offset:X}，正常发送")
+                continue
+            pos = offset + length
+            if progress_callback:
+                progress_callback(min(100, int((pos - start) * 100 / total)), self.next_seq - 1,
+                                  pos - start, total)
+
+        return True, "数据发送完成"
+
     def reset_transfer_state(self, log_callback=None):
         """重置传输状态和清空串口缓冲区"""
         if self.serial_port and self.serial_port.is_open:
@@ -285,7 +757,9 @@ class SimpleYModemSender:
             if not os.path.exists(file_path):
                 return False, "文件不存在"
 
-            file_size = os.path.getsize(file_path)
+            with open(file_path, 'rb') as f:
+                file_data = f.read()
+            file_size = len(file_data)
             filename = os.path.basename(file_path)
 
             if log_callback:
@@ -303,7 +777,22 @@ class SimpleYModemSender:
                 return False, "传输被用户取消"
 
             # 第二阶段：文件头发送
-            if not self.send_file_header(filename, file_size, log_callback):
+            options = {}
+            if self.handshake != self.G and self.request_window > 1:
+                options['win'] = self.request_window
+            if self.max_baudrate > self.base_baudrate:
+                options['baud'] = self.max_baudrate
+            if self.request_block > 1024:
+                options['blk'] = self.request_block
+            # 压缩包和差分包解压后的内容与页不对应，不做差异页传输；
+            # 差异页传输已跳过设备中相同的页，不再请求续传
+            compressed = (len(file_data) >= 8 and struct.unpack('<I', file_data[:4])[0] == self.FIRMWARE_MAGIC
+                          and file_data[7] & 0x03)
+            if self.page_diff and self.handshake != self.G and not compressed:
+                options['pages'] = 1
+            elif self.resume and self.handshake != self.G:
+                options['resume'] = binascii.crc32(file_data) & 0xFFFFFFFF
+            if not self.send_file_header(filename, file_size, log_callback, options):
                 return False, "文件头发送失败"
 
             if self.is_cancelled:
@@ -313,51 +802,41 @@ class SimpleYModemSender:
             if log_callback:
                 log_callback("第三阶段：数据传输开始...")
 
-            packet_num = 1
-            bytes_sent = 0
-
-            with open(file_path, 'rb') as file:
-                while not self.is_cancelled and bytes_sent < file_size:
-                    # 根据剩余字节数决定读取大小
-                    remaining = file_size - bytes_sent
-
-                    if remaining >= 1024:
-                        # 读取1024字节使用STX包
-                        data = file.read(1024)
-                    else:
-                        # 剩余不足1024字节，按128字节读取使用SOH包
-                        read_size = min(128, remaining)
-                        data = file.read(read_size)
-
-                    if not data:
-                        break
-
-                    bytes_sent += len(data)
-
-                    # 进度更新
-                    if progress_callback:
-                        progress = min(100, int((bytes_sent / file_size) * 100))
-                        progress_callback(progress, packet_num, bytes_sent, file_size)
-
-                    if log_callback and packet_num % 10 == 0:
-                        log_callback(f"传输进度: {progress}% ({bytes_sent}/{file_size} 字节)")
+            # 差异页传输：下发页计划后只发送变化的页，设备按页计划依次写入
+            if self.page_crcs:
+                plan, file_data = self.plan_pages(file_data)
+                if log_callback:
+                    log_callback(f"差异页传输：发送 {plan.count(self.PAGE_SEND)} 页，"
+                                 f"保留 {plan.count(self.PAGE_KEEP)} 页，复制 {plan.count(self.PAGE_COPY)} 页，"
+                                 f"擦除 {plan.count(self.PAGE_ERASE)} 页")
+                if not self.send_page_map(plan, log_callback):
+                    return False, "页计划执行失败"
+                file_size = len(file_data)
+
+            # 设备已有前resume_offset字节（页对齐），只发送剩余部分
+            start = 0
+            if 0 < self.resume_offset < file_size:
+                if log_callback:
+                    log_callback(f"断点续传：设备已写入 {self.resume_offset} 字节，"
+                                 f"只发送剩余 {file_size - self.resume_offset} 字节")
+                start = self.resume_offset
 
-                    # 数据包发送（最大重试3次）
-                    success = False
-                    for retry in range(3):
-                        if self.send_data_packet(packet_num, data, log_callback):
-                            success = True
-                            break
-                        elif self.is_cancelled:
-                            break
-                        else:
-                            if log_callback:
-                                log_callback(f"数据包 {packet_num} 第 {retry + 1} 次重试")
+            # 原始固件包中整段的0xFF不传输；页计划已按页处理空白页，流式模式不等待应答，均不跳过
+            runs = []
+            if self.skip_erased and not self.page_crcs and not compressed and self.handshake != self.G:
+                runs = self.find_erased_runs(file_data, start)
+                if runs and log_callback:
+                    log_callback(f"擦除区跳过：{len(runs)} 段共 {sum(r[1] for r in runs)} 字节不传输")
 
-                    if not success:
-                        return False, f"数据包 {packet_num} 发送失败"
+            if log_callback:
+                if self.handshake == self.G:
+                    log_callback("YMODEM-G流式传输，不等待逐包应答")
+                elif self.window > 1:
+                    log_callback(f"滑动窗口传输，窗口大小 {self.window}")
+            success, message = self.send_payload(file_data, start, runs, progress_callback, log_callback)
 
-                    packet_num += 1
+            if not success:
+                return False, message
 
             if self.is_cancelled:
                 return False, "传输被用户取消"
@@ -422,6 +901,155 @@ class SimpleYModemSender:
             if log_callback:
                 log_callback(f"发送过程出错: {str(e)}")
             return False, f"发送过程出错: {str(e)}"
+        finally:
+            # 设备在传输结束或取消后恢复默认波特率，这里保持一致
+            if self.serial_port and self.serial_port.is_open:
+                self.serial_port.baudrate = self.base_baudrate
+
+    def select_node(self, node_id):
+        """多机总线：选择会话节点（NODE_BROADCAST=广播），节点不应答"""
+        self.send_data(self.build_ext(self.EXT_SELECT, bytes([node_id])))
+
+    def poll_node(self, node_id):
+        """多机总线：查询节点，返回(接收状态, 已收数据包位图)，无应答返回None"""
+        self.serial_port.reset_input_buffer()
+        self.send_data(self.build_ext(self.EXT_POLL, bytes([node_id])))
+        if self.receive_byte(self.poll_timeout) != self.EXT:
+            return None
+        ext = self.receive_ext(self.poll_timeout)
+        if not ext or ext[0] != self.EXT_POLL or len(ext[1]) != 6 or ext[1][0] != node_id:
+            return None
+        return ext[1][1], struct.unpack('<I', ext[1][2:6])[0]
+
+    def send_file_fleet(self, file_path, nodes, progress_callback=None, log_callback=None):
+        """多机总线批量升级：所有节点同时接收广播的数据包，逐个查询后补发缺失的包
+
+        总耗时约为一次传输加每轮查询（每个节点几毫秒），基本不随节点数增长。
+        节点收齐数据后广播EOT，各节点校验固件并在查询应答中上报结果后跳转到新固件，
+        只有上报校验通过的节点计为升级完成，没有上报的节点记为未确认。
+        """
+        try:
+            self.reset_transfer_state(log_callback)
+
+            with open(file_path, 'rb') as f:
+                file_data = f.read()
+            file_size = len(file_data)
+            packets = (file_size + self.PAGE_SIZE - 1) // self.PAGE_SIZE
+
+            # 广播会话按页写入，不支持压缩包和差分包
+            if (len(file_data) >= 8 and struct.unpack('<I', file_data[:4])[0] == self.FIRMWARE_MAGIC
+                    and file_data[7] & 0x03):
+                return False, "批量升级不支持压缩包和差分包"
+            if packets == 0 or packets > self.BCAST_MAX_PACKETS:
+                return False, f"文件大小超出广播会话范围（最多{self.BCAST_MAX_PACKETS}KB）"
+
+            # 第一阶段：确认在线节点
+            online = [n for n in nodes if self.poll_node(n) is not None]
+            failed = {n: "无应答" for n in nodes if n not in online}
+            if log_callback:
+                log_callback(f"在线节点 {len(online)}/{len(nodes)}: {online}")
+            if not online:
+                return False, "没有在线节点"
+
+            # 第二阶段起：广播起始帧并等待节点擦除，再广播数据包，查询位图后补发。
+            # 漏收起始帧的节点仍处于等待状态，下一轮重发起始帧（已在接收数据的节点忽略序号0的包）
+            self.select_node(self.NODE_BROADCAST)
+            header = self.build_header_packet(os.path.basename(file_path), file_size)
+            chunks = [file_data[i * self.PAGE_SIZE:(i + 1) * self.PAGE_SIZE].ljust(self.PAGE_SIZE, b'\x1a')
+                      for i in range(packets)]
+            pending = set(range(packets))
+            need_header = True
+            for round_num in range(self.bcast_rounds):
+                if need_header:
+                    self.send_data(header)
+                    self.serial_port.flush()
+                    time.sleep(self.bcast_erase_time * packets + 0.2)
+
+                for count, idx in enumerate(sorted(pending)):
+                    if self.is_cancelled:
+                        return False, "传输被用户取消"
+                    self.send_data(self.build_data_packet(idx + 1, chunks[idx]))
+                    if progress_callback:
+                        progress_callback(int((count + 1) * 100 / len(pending)), idx + 1,
+                                          (count + 1) * self.PAGE_SIZE, len(pending) * self.PAGE_SIZE)
+                self.serial_port.flush()
+                time.sleep(0.1)  # 等节点写完缓冲池中的数据包
+
+                pending = set()
+                need_header = False
+                for n in list(online):
+                    result = self.poll_node(n)
+                    if result is None:
+                        failed[n] = "传输中断"
+                        online.remove(n)
+                        continue
+                    if result[0] == 0:
+                        need_header = True
+                    pending.update(i for i in range(packets) if not (result[1] >> i) & 1)
+
+                if not pending:
+                    break
+                if log_callback:
+                    log_callback(f"第 {round_num + 1} 轮查询：补发 {len(pending)} 个数据包")
+
+            if pending:
+                for n in online:
+                    failed[n] = "数据包缺失"
+                online = []
+
+            # 第四阶段：广播EOT，节点收齐数据才会结束，校验固件后在查询应答中上报结果；
+            # 仍在等待结束的节点重发EOT，应答丢失的节点再次查询
+            upgraded = []
+            for _ in range(3):
+                if not online:
+                    break
+                self.send_byte(self.EOT)
+                time.sleep(0.05)
+                self.send_byte(self.EOT)
+                self.serial_port.flush()
+                time.sleep(0.1)
+                for n in list(online):
+                    result = self.poll_node(n)
+                    if result is None or result[0] not in (self.BCAST_VERIFIED, self.BCAST_REJECTED):
+                        continue
+                    online.remove(n)
+                    if result[0] == self.BCAST_VERIFIED:
+                        upgraded.append(n)
+                    else:
+                        failed[n] = "固件校验失败"
+
+            # 没有上报结果的节点可能已跳转（应答丢失），也可能已离线，不能计为成功
+            unconfirmed = online
+
+            if log_callback:
+                for n, reason in sorted(failed.items()):
+                    log_callback(f"节点 {n} 升级失败: {reason}")
+                for n in unconfirmed:
+                    log_callback(f"节点 {n} 未确认: 没有上报校验结果")
+            if failed or unconfirmed:
+                message = f"{len(upgraded)}/{len(nodes)} 个节点升级完成"
+                if unconfirmed:
+                    message += f"，{len(unconfirmed)} 个未确认"
+                return False, message
+            return True, f"{len(nodes)} 个节点升级完成"
+
+        except Exception as e:
+            if log_callback:
+                log_callback(f"批量升级出错: {str(e)}")
+            return False, f"批量升级出错: {str(e)}"
+
+    @staticmethod
+    def parse_nodes(text):
+        """解析节点列表，如"1,2,5-9"，空字符串返回空列表（点对点）"""
+        nodes = []
+        for part in text.replace(' ', '').split(','):
+            if not part:
+                continue
+            first, _, last = part.partition('-')
+            nodes.extend(range(int(first), int(last or first) + 1))
+        if any(n < 1 or n > 254 for n in nodes):
+            raise ValueError("节点号范围为1-254")
+        return sorted(set(nodes))
 
     def cancel_transfer(self):
         """取消当前传输"""
@@ -502,6 +1130,15 @@ class FirmwareUpdater:
 
         ttk.Button(file_row, text="浏览", command=self.browse_file).pack(side=tk.LEFT, padx=5)
 
+        # 多机总线节点（留空为点对点升级）
+        node_row = ttk.Frame(file_frame)
+        node_row.pack(fill=tk.X, pady=(5, 0))
+
+        ttk.Label(node_row, text="总线节点:").pack(side=tk.LEFT)
+        self.nodes_var = tk.StringVar()
+        ttk.Entry(node_row, textvariable=self.nodes_var, width=30).pack(side=tk.LEFT, padx=5)
+        ttk.Label(node_row, text="留空=点对点，批量升级如 1,2,5-9", foreground="gray").pack(side=tk.LEFT)
+
         # 进度显示区域
         progress_frame = ttk.LabelFrame(main_frame, text="传输进度", padding="5")
         progress_frame.pack(fill=tk.X, pady=5)
@@ -669,6 +1306,17 @@ class FirmwareUpdater:
         self.root.after(0, lambda: self.progress_bar.config(value=0))
         self.root.after(0, lambda: self.progress_text.config(text="正在传输..."))
 
+        progress_callback = lambda p, pn, c, t: self.root.after(0, lambda: self.update_progress(p, pn, c, t))
+        log_callback = lambda m: self.root.after(0, lambda msg=m: self.log_message(msg))
+
+        # 多机总线批量升级
+        try:
+            nodes = self.ymodem.parse_nodes(self.nodes_var.get())
+        except ValueError as e:
+            return False, f"节点列表无效: {e}"
+        if nodes:
+            return self.ymodem.send_file_fleet(self.file_var.get(), nodes, progress_callback, log_callback)
+
         # 执行传输
         success, message = self.ymodem.send_file(
             self.file_var.get(),
@@ -0,0 +1,952 @@
+"""
+多机总线仿真测试 - 在主机上用伪终端组成RS-485总线，批量升级多个仿真节点
+
+功能：
+1. Bootloader的协议层、配置区、校验和串口驱动（Boot目录下的源文件，不做修改）
+   与主机仿真层一起用主机C编译器编译，每个进程是一个节点：
+   - 外设寄存器、Flash映射到与STM32相同的地址，Flash按NOR特性仿真（擦除置1、编程只能写入擦除过的半字）
+   - 串口、DMA、定时器中断用信号模拟：信号处理函数调用中断处理函数，关中断即屏蔽信号，
+     屏蔽期间触发的中断保持挂起，与NVIC一致；主循环每轮处理完等待下一个中断（相当于WFI）
+2. 每个节点连接一个伪终端，总线线程把主机发出的数据送到所有节点，
+   节点发出的数据送到主机和其他节点，模拟半双工多机总线
+3. 检查RS-485方向控制：DE为低时发出数据、DE为高期间（收发器处于发送）收到数据都计为错误
+4. 用firmware_update.py的send_file_fleet批量升级，并让一个节点漏收一个数据包以走查询补发流程，
+   最后核对各节点的升级状态、激活分区和分区内容
+
+使用方法：
+    python fleet_sim.py [节点数] [--irq]
+
+示例：
+    python fleet_sim.py          -3个节点，默认串口配置（DMA收发）
+    python fleet_sim.py 5 --irq  -5个节点，逐字节RXNE接收、TXE中断发送
+"""
+
+import contextlib
+import io
+import os
+import re
+import select
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+import tty
+import types
+
+TOOLS_DIR = os.path.dirname(os.path.abspath(__file__))
+BOOT_DIR = os.path.join(TOOLS_DIR, '..', 'Boot')
+
+# 主机上编译的Bootloader源文件（main.c、LED、按键和SysTick由仿真层代替）
+BOOT_SOURCES = [
+    'Protocol/YModem/ymodem.c',
+    'Protocol/YModem/crc16.c',
+    'IAP/Bootloader/bootloader.c',
+    'IAP/Config/config_manager.c',
+    'IAP/Verify/crc32.c',
+    'IAP/Verify/firmware_verify.c',
+    'IAP/Decompress/lz_stream.c',
+]
+BOOT_INCLUDES = [
+    'BSP/KEY', 'BSP/LED', 'Core/Inc', 'IAP/Bootloader', 'IAP/Config', 'IAP/Verify',
+    'IAP/Decompress', 'Libraries/FWlib/inc', 'Protocol/YModem',
+]
+
+FLASH_BASE = 0x08000000
+FLASH_SIZE = 64 * 1024
+APP_BANK_ADDR = (0x08004800, 0x08009800)
+UPGRADE_STATUS_SUCCESS = 0x04
+
+# 主机仿真层和节点主程序：节点程序参数为"伪终端 节点号 Flash镜像文件"，
+# 升级流程结束后输出一行结果并把Flash写回镜像文件
+C_NODE_SOURCE = r'''
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include "stm32f10x.h"
+#include "bsp_usart.h"
+#include "bsp_led.h"
+#include "sysTick.h"
+#include "bootloader.h"
+#include "config_manager.h"
+#include "ymodem.h"
+
+#ifndef DEBUG_USART_RS485
+#define DEBUG_USART_RS485 0
+#endif
+
+#define SIM_PAGE_ERASE_US   20000   /* 页擦除时间，期间CPU停顿，中断延后 */
+#define SIM_BYTE_TIMEOUT_MS 20      /* TIM3字节间超时 */
+#define SIM_TICK_US         1000    /* 定时中断周期：轮询总线数据和TIM3 */
+#define SIM_RX_BURST        64      /* 总线线程一次送来的最大字节数 */
+
+system_config_t g_config;
+
+extern void USART1_IRQHandler(void);
+extern void TIM3_IRQHandler(void);
+#if DEBUG_USART_RX_DMA
+extern void DEBUG_USART_RX_DMA_IRQHandler(void);
+#endif
+#if DEBUG_USART_TX_DMA
+extern void DEBUG_USART_TX_DMA_IRQHandler(void);
+#endif
+
+static int bus_fd = -1;
+
+/* 中断 = SIGALRM：周期定时器和发送完成都会触发；关中断即屏蔽该信号 */
+static volatile sig_atomic_t irq_masked;
+static volatile sig_atomic_t irq_active;
+static sigset_t irq_set;
+
+/* 串口状态寄存器和已使能的中断（按状态位记录） */
+static volatile uint16_t usart_sr = USART_FLAG_TXE | USART_FLAG_TC;
+static volatile uint16_t usart_ie;
+static volatile uint8_t usart_dr;
+static volatile uint32_t dma_isr;
+static uint16_t rx_dma_size;
+
+static volatile int tim3_on;
+static volatile int tim3_flag;
+static volatile double tim3_start;
+
+static volatile int flash_locked = 1;
+
+static volatile int de_level;
+static volatile unsigned long de_errors;
+static volatile unsigned long rx_dropped;
+
+/* 置中断挂起：关中断或正在处理中断时，返回后再进入 */
+static void irq_pend(void)
+{
+    raise(SIGALRM);
+}
+
+static void sleep_us(uint32_t us)
+{
+    struct timespec ts = { us / 1000000, (us % 1000000) * 1000 };
+    while (nanosleep(&ts, &ts) != 0) {
+    }
+}
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void bus_write(const uint8_t *buf, uint32_t len)
+{
+    ssize_t n;
+
+    if (DEBUG_USART_RS485 && !de_level) {
+        de_errors += len;
+    }
+    while (len > 0) {
+        n = write(bus_fd, buf, len);
+        if (n > 0) {
+            buf += n;
+            len -= n;
+        } else {
+            struct pollfd pfd = { bus_fd, POLLOUT, 0 };
+            poll(&pfd, 1, 10);
+        }
+    }
+}
+
+/* ---------------------------- Cortex-M3内核 ---------------------------- */
+/* 中断处理中同优先级的中断不会嵌套，PRIMASK只记录不改变信号屏蔽 */
+void __disable_irq(void)
+{
+    if (!irq_masked) {
+        irq_masked = 1;
+        if (!irq_active) {
+            sigprocmask(SIG_BLOCK, &irq_set, NULL);
+        }
+    }
+}
+
+void __enable_irq(void)
+{
+    if (irq_masked) {
+        irq_masked = 0;
+        if (!irq_active) {
+            sigprocmask(SIG_UNBLOCK, &irq_set, NULL);
+        }
+    }
+}
+
+uint32_t __get_PRIMASK(void) { return irq_masked; }
+void __set_PRIMASK(uint32_t mask) { if (mask) __disable_irq(); else __enable_irq(); }
+void __enable_fault_irq(void) {}
+void __disable_fault_irq(void) {}
+void __NOP(void) {}
+void __WFI(void) {}
+void __WFE(void) {}
+void __SEV(void) {}
+void __ISB(void) {}
+void __DMB(void) {}
+void __CLREX(void) {}
+void __set_MSP(uint32_t top) { (void)top; }
+void __set_CONTROL(uint32_t control) { (void)control; }
+
+uint32_t __RBIT(uint32_t value)
+{
+    uint32_t r = 0;
+    int i;
+    for (i = 0; i < 32; i++) {
+        r = (r << 1) | ((value >> i) & 1);
+    }
+    return r;
+}
+
+/* NVIC_SystemReset写AIRCR后执行__DSB：节点在这里结束 */
+void __DSB(void)
+{
+    if (SCB->AIRCR & SCB_AIRCR_SYSRESETREQ_Msk) {
+        dprintf(1, "reset\n");
+        _exit(3);
+    }
+}
+
+/* ------------------------------ 时钟、NVIC ------------------------------ */
+void RCC_APB2PeriphClockCmd(uint32_t periph, FunctionalState state) { (void)periph; (void)state; }
+void RCC_APB1PeriphClockCmd(uint32_t periph, FunctionalState state) { (void)periph; (void)state; }
+void RCC_AHBPeriphClockCmd(uint32_t periph, FunctionalState state) { (void)periph; (void)state; }
+void NVIC_PriorityGroupConfig(uint32_t group) { (void)group; }
+void NVIC_Init(NVIC_InitTypeDef *init) { (void)init; }
+
+/* -------------------------------- GPIO -------------------------------- */
+void GPIO_Init(GPIO_TypeDef *port, GPIO_InitTypeDef *init) { (void)port; (void)init; }
+
+void GPIO_SetBits(GPIO_TypeDef *port, uint16_t pin)
+{
+#if DEBUG_USART_RS485
+    if (port == DEBUG_USART_DE_GPIO_PORT && (pin & DEBUG_USART_DE_GPIO_PIN)) {
+        de_level = 1;
+    }
+#else
+    (void)port; (void)pin;
+#endif
+}
+
+void GPIO_ResetBits(GPIO_TypeDef *port, uint16_t pin)
+{
+    static int ready;
+
+    /* upgrade_process点亮LED后随即开始接收，通知主机可以发送 */
+    if (port == LED1_GPIO_PORT && (pin & LED1_GPIO_PIN) && !ready) {
+        ready = 1;
+        dprintf(1, "ready\n");
+    }
+#if DEBUG_USART_RS485
+    if (port == DEBUG_USART_DE_GPIO_PORT && (pin & DEBUG_USART_DE_GPIO_PIN)) {
+        de_level = 0;
+    }
+#endif
+}
+
+/* -------------------------------- USART -------------------------------- */
+#define USART_IT_BIT(it)    ((uint16_t)(1u << (((it) >> 8) & 0x0F)))
+
+void USART_Init(USART_TypeDef *usart, USART_InitTypeDef *init) { (void)usart; (void)init; }
+void USART_Cmd(USART_TypeDef *usart, FunctionalState state) { (void)usart; (void)state; }
+void USART_DMACmd(USART_TypeDef *usart, uint16_t req, FunctionalState state) { (void)usart; (void)req; (void)state; }
+
+void USART_ITConfig(USART_TypeDef *usart, uint16_t it, FunctionalState state)
+{
+    (void)usart;
+    if (state != DISABLE) {
+        usart_ie |= USART_IT_BIT(it);
+        irq_pend();
+    } else {
+        usart_ie &= ~USART_IT_BIT(it);
+    }
+}
+
+ITStatus USART_GetITStatus(USART_TypeDef *usart, uint16_t it)
+{
+    (void)usart;
+    return (usart_ie & usart_sr & USART_IT_BIT(it)) ? SET : RESET;
+}
+
+void USART_ClearITPendingBit(USART_TypeDef *usart, uint16_t it)
+{
+    (void)usart;
+    usart_sr &= ~(USART_IT_BIT(it) & (USART_FLAG_RXNE | USART_FLAG_TC));
+}
+
+FlagStatus USART_GetFlagStatus(USART_TypeDef *usart, uint16_t flag)
+{
+    (void)usart;
+    return (usart_sr & flag) ? SET : RESET;
+}
+
+void USART_ClearFlag(USART_TypeDef *usart, uint16_t flag)
+{
+    (void)usart;
+    usart_sr &= ~(flag & (USART_FLAG_RXNE | USART_FLAG_TC));
+}
+
+void USART_SendData(USART_TypeDef *usart, uint16_t data)
+{
+    uint8_t byte = (uint8_t)data;
+    (void)usart;
+    bus_write(&byte, 1);
+    usart_sr |= USART_FLAG_TXE | USART_FLAG_TC;
+    irq_pend();
+}
+
+uint16_t USART_ReceiveData(USART_TypeDef *usart)
+{
+    (void)usart;
+    usart_sr &= ~(USART_FLAG_RXNE | USART_FLAG_IDLE);
+    return usart_dr;
+}
+
+/* --------------------------------- DMA --------------------------------- */
+void DMA_DeInit(DMA_Channel_TypeDef *ch)
+{
+    ch->CCR = 0;
+    ch->CNDTR = 0;
+    ch->CPAR = 0;
+    ch->CMAR = 0;
+}
+
+void DMA_Init(DMA_Channel_TypeDef *ch, DMA_InitTypeDef *init)
+{
+    ch->CPAR = init->DMA_PeripheralBaseAddr;
+    ch->CMAR = init->DMA_MemoryBaseAddr;
+    ch->CNDTR = init->DMA_BufferSize;
+    if (init->DMA_DIR == DMA_DIR_PeripheralSRC) {
+        rx_dma_size = init->DMA_BufferSize;
+    }
+}
+
+void DMA_ITConfig(DMA_Channel_TypeDef *ch, uint32_t it, FunctionalState state)
+{
+    if (state != DISABLE) {
+        ch->CCR |= it;
+    } else {
+        ch->CCR &= ~it;
+    }
+}
+
+/* 发送通道使能后数据立即送上总线，置传输完成标志 */
+void DMA_Cmd(DMA_Channel_TypeDef *ch, FunctionalState state)
+{
+    if (state == DISABLE) {
+        ch->CCR &= ~DMA_CCR1_EN;
+        return;
+    }
+    ch->CCR |= DMA_CCR1_EN;
+#if DEBUG_USART_TX_DMA
+    if (ch == DEBUG_USART_TX_DMA_CHANNEL && ch->CNDTR != 0) {
+        bus_write((const uint8_t *)(uintptr_t)ch->CMAR, ch->CNDTR);
+        ch->CNDTR = 0;
+        dma_isr |= DEBUG_USART_TX_DMA_FLAG_TC;
+        usart_sr |= USART_FLAG_TC;
+        irq_pend();
+    }
+#endif
+}
+
+uint16_t DMA_GetCurrDataCounter(DMA_Channel_TypeDef *ch) { return (uint16_t)ch->CNDTR; }
+FlagStatus DMA_GetFlagStatus(uint32_t flag) { return (dma_isr & flag) ? SET : RESET; }
+void DMA_ClearFlag(uint32_t flag) { dma_isr &= ~flag; }
+ITStatus DMA_GetITStatus(uint32_t it) { return (dma_isr & it) ? SET : RESET; }
+void DMA_ClearITPendingBit(uint32_t it) { dma_isr &= ~it; }
+
+/* --------------------------------- TIM --------------------------------- */
+void TIM_TimeBaseInit(TIM_TypeDef *tim, TIM_TimeBaseInitTypeDef *init) { (void)tim; (void)init; }
+void TIM_ITConfig(TIM_TypeDef *tim, uint16_t it, FunctionalState state) { (void)tim; (void)it; (void)state; }
+
+void TIM_Cmd(TIM_TypeDef *tim, FunctionalState state)
+{
+    (void)tim;
+    tim3_on = (state != DISABLE);
+    tim3_start = now_ms();
+}
+
+ITStatus TIM_GetITStatus(TIM_TypeDef *tim, uint16_t it) { (void)tim; (void)it; return tim3_flag ? SET : RESET; }
+void TIM_ClearITPendingBit(TIM_TypeDef *tim, uint16_t it) { (void)tim; (void)it; tim3_flag = 0; }
+
+/* -------------------------------- FLASH -------------------------------- */
+void FLASH_Unlock(void) { flash_locked = 0; }
+void FLASH_Lock(void) { flash_locked = 1; }
+
+FLASH_Status FLASH_ErasePage(uint32_t addr)
+{
+    sigset_t old;
+
+    if (flash_locked || addr < FLASH_START_ADDR || addr >= FLASH_END_ADDR) {
+        return FLASH_ERROR_PG;
+    }
+    sigprocmask(SIG_BLOCK, &irq_set, &old);
+    sleep_us(SIM_PAGE_ERASE_US);
+    sigprocmask(SIG_SETMASK, &old, NULL);
+    memset((void *)(uintptr_t)(addr & ~(uint32_t)(FLASH_SECTOR_SIZE - 1)), 0xFF, FLASH_SECTOR_SIZE);
+    return FLASH_COMPLETE;
+}
+
+/* NOR Flash：只能编程擦除过的半字（写0除外），否则置PGERR */
+FLASH_Status FLASH_ProgramHalfWord(uint32_t addr, uint16_t data)
+{
+    volatile uint16_t *p = (volatile uint16_t *)(uintptr_t)addr;
+
+    if (flash_locked || (addr & 1) || addr < FLASH_START_ADDR || addr >= FLASH_END_ADDR) {
+        return FLASH_ERROR_PG;
+    }
+    if (*p != 0xFFFF && data != 0) {
+        return FLASH_ERROR_PG;
+    }
+    *p = data;
+    return FLASH_COMPLETE;
+}
+
+/* ------------------------------ LED、延时 ------------------------------ */
+void LED_GPIO_Config(void) {}
+void led_status_indicate(uint8_t code) { (void)code; }
+void led_fast_blink(uint8_t times, uint16_t interval_ms) { (void)times; (void)interval_ms; }
+void SysTick_Init(void) {}
+void delay_us(__IO u32 n) { sleep_us(n); }
+void SysTick_Delay_Us(__IO uint32_t us) { sleep_us(us); }
+void SysTick_Delay_Ms(__IO uint32_t ms) { sleep_us(ms * 1000); }
+
+/* --------------------------------- 中断 --------------------------------- */
+/* 发送中断：DMA发送完成、TXE、TC */
+static void isr_tx(void)
+{
+    int n;
+
+    for (n = 0; n < 4096; n++) {
+#if DEBUG_USART_TX_DMA
+        if ((dma_isr & DEBUG_USART_TX_DMA_FLAG_TC) && (DEBUG_USART_TX_DMA_CHANNEL->CCR & DMA_IT_TC)) {
+            DEBUG_USART_TX_DMA_IRQHandler();
+            continue;
+        }
+#endif
+        if (USART_GetITStatus(DEBUG_USARTx, USART_IT_TXE) || USART_GetITStatus(DEBUG_USARTx, USART_IT_TC)) {
+            USART1_IRQHandler();
+            continue;
+        }
+        break;
+    }
+}
+
+static void isr_timer(void)
+{
+    if (tim3_on && now_ms() - tim3_start >= SIM_BYTE_TIMEOUT_MS) {
+        tim3_flag = 1;
+        tim3_start = now_ms();
+        TIM3_IRQHandler();
+    }
+}
+
+static void rx_byte(uint8_t byte)
+{
+#if DEBUG_USART_RX_DMA
+    DMA_Channel_TypeDef *ch = DEBUG_USART_RX_DMA_CHANNEL;
+
+    if (!(ch->CCR & DMA_CCR1_EN) || rx_dma_size == 0) {
+        rx_dropped++;
+        return;
+    }
+    ((uint8_t *)(uintptr_t)ch->CMAR)[rx_dma_size - ch->CNDTR] = byte;
+    if (--ch->CNDTR == rx_dma_size / 2) {
+        dma_isr |= DEBUG_USART_RX_DMA_IT_HT;
+    } else if (ch->CNDTR == 0) {
+        ch->CNDTR = rx_dma_size;
+        dma_isr |= DEBUG_USART_RX_DMA_IT_TC;
+    }
+    if ((dma_isr & DEBUG_USART_RX_DMA_IT_HT && ch->CCR & DMA_IT_HT) ||
+        (dma_isr & DEBUG_USART_RX_DMA_IT_TC && ch->CCR & DMA_IT_TC)) {
+        DEBUG_USART_RX_DMA_IRQHandler();
+    }
+#else
+    if (!(usart_ie & USART_FLAG_RXNE)) {
+        rx_dropped++;
+        return;
+    }
+    usart_dr = byte;
+    usart_sr |= USART_FLAG_RXNE;
+    USART1_IRQHandler();
+#endif
+}
+
+/* 读满len字节：总线线程一次写入一段，段内数据随即全部到达 */
+static int bus_read_all(uint8_t *buf, size_t len)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        n = read(bus_fd, buf, len);
+        if (n > 0) {
+            buf += n;
+            len -= n;
+        } else if (n == 0 || errno != EAGAIN) {
+            return 0;
+        } else {
+            struct pollfd pfd = { bus_fd, POLLIN, 0 };
+            poll(&pfd, 1, 10);
+        }
+    }
+    return 1;
+}
+
+/* 接收：总线线程把线路上连续发出的一段数据加2字节长度送来，每次中断收一段，
+ * 段后线路空闲（IDLE），主循环在段与段之间执行，与真实线路的时序一致；
+ * 收发器处于发送（DE为高）时收不到总线上的数据 */
+static void isr_rx(void)
+{
+    uint8_t buf[SIM_RX_BURST];
+    uint16_t len, i;
+
+    if (read(bus_fd, &len, 1) != 1) {
+        return;
+    }
+    if (!bus_read_all((uint8_t *)&len + 1, 1) || len > sizeof(buf) || !bus_read_all(buf, len)) {
+        dprintf(2, "bus framing error\n");
+        _exit(1);
+    }
+    for (i = 0; i < len; i++) {
+        if (DEBUG_USART_RS485 && de_level) {
+            rx_dropped++;
+            continue;
+        }
+        rx_byte(buf[i]);
+    }
+#if DEBUG_USART_RX_DMA
+    usart_sr |= USART_FLAG_IDLE;
+    if (USART_GetITStatus(DEBUG_USARTx, USART_IT_IDLE)) {
+        USART1_IRQHandler();
+    }
+#endif
+}
+
+static void irq_handler(int sig)
+{
+    sig_atomic_t masked = irq_masked;
+
+    (void)sig;
+    irq_active = 1;
+    irq_masked = 0;
+    isr_tx();
+    isr_timer();
+    isr_rx();
+    isr_tx();
+    irq_active = 0;
+    irq_masked = masked;
+}
+
+/* 主循环每轮处理完后等待下一个中断（相当于WFI），不空转占用CPU：
+ * ymodem.c编译时把ymodem_process改名为ymodem_process_target，bootloader.c调用这里 */
+extern void ymodem_process_target(void);
+
+void ymodem_process(void)
+{
+    sigset_t old;
+
+    ymodem_process_target();
+    sigprocmask(SIG_BLOCK, &irq_set, &old);
+    if (!irq_masked) {
+        sigsuspend(&old);
+    }
+    sigprocmask(SIG_SETMASK, &old, NULL);
+}
+
+static void map_region(uint32_t addr, uint32_t size)
+{
+    void *p = mmap((void *)(uintptr_t)addr, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (p != (void *)(uintptr_t)addr) {
+        dprintf(2, "mmap 0x%08X failed\n", (unsigned)addr);
+        _exit(1);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct sigaction sa;
+    struct itimerval tick = { { 0, SIM_TICK_US }, { 0, SIM_TICK_US } };
+    int fd;
+
+    if (argc != 4) {
+        dprintf(2, "usage: %s tty node_id flash.bin\n", argv[0]);
+        return 1;
+    }
+
+    map_region(FLASH_START_ADDR, FLASH_END_ADDR - FLASH_START_ADDR);
+    map_region(PERIPH_BASE, 0x30000);
+    map_region(SCS_BASE, 0x1000);
+    memset((void *)(uintptr_t)FLASH_START_ADDR, 0xFF, FLASH_END_ADDR - FLASH_START_ADDR);
+    fd = open(argv[3], O_RDONLY);
+    if (fd >= 0) {
+        if (read(fd, (void *)(uintptr_t)FLASH_START_ADDR, FLASH_END_ADDR - FLASH_START_ADDR) < 0) {
+            _exit(1);
+        }
+        close(fd);
+    }
+
+    bus_fd = open(argv[1], O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (bus_fd < 0) {
+        dprintf(2, "open %s failed\n", argv[1]);
+        return 1;
+    }
+
+    /* 中断处理期间屏蔽中断，同优先级不嵌套 */
+    sigemptyset(&irq_set);
+    sigaddset(&irq_set, SIGALRM);
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = irq_handler;
+    sa.sa_mask = irq_set;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGALRM, &sa, NULL);
+
+    /* 与main.c相同的启动顺序，节点号来自参数 */
+    if (!init_system_config()) {
+        return 1;
+    }
+    g_config.node_id = (uint8_t)atoi(argv[2]);
+    ymodem_init();
+    setitimer(ITIMER_REAL, &tick, NULL);
+
+    upgrade_process();
+    Usart_Tx_Flush();
+
+    dprintf(1, "node=%u active=%u status=%u de=%d de_errors=%lu rx_dropped=%lu\n",
+            g_config.node_id, g_config.active_bank, g_config.upgrade_status,
+            de_level, de_errors, rx_dropped);
+
+    fd = open(argv[3], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || write(fd, (void *)(uintptr_t)FLASH_START_ADDR, FLASH_END_ADDR - FLASH_START_ADDR) < 0) {
+        _exit(1);
+    }
+    close(fd);
+    _exit(0);
+}
+'''
+
+
+def patch_core_cm3(text):
+    """GNU编译器分支中的内联汇编（cpsie/cpsid等）改为外部函数，由仿真层实现"""
+    begin = text.index('#elif (defined (__GNUC__))')
+    end = text.index('#elif (defined (__TASKING__))', begin)
+    section = re.sub(r'static __INLINE void (\w+)\(\)\s*\{ __ASM volatile \("[^"]*"\); \}',
+                     r'extern void \1(void);', text[begin:end])
+    return text[:begin] + section + text[end:]
+
+
+def prepare_sources(workdir, irq_mode):
+    """生成主机编译用的头文件：CMSIS内核头去掉内联汇编，串口配置按收发方式改写"""
+    cmsis_dir = os.path.join(workdir, 'cmsis')
+    usart_dir = os.path.join(workdir, 'usart')
+    os.makedirs(cmsis_dir)
+    os.makedirs(usart_dir)
+
+    cmsis_src = os.path.join(BOOT_DIR, 'Libraries', 'CMSIS')
+    for name in ('stm32f10x.h', 'system_stm32f10x.h'):
+        shutil.copy(os.path.join(cmsis_src, name), cmsis_dir)
+    with open(os.path.join(cmsis_src, 'core_cm3.h'), 'rb') as f:
+        text = f.read().decode('latin-1')
+    with open(os.path.join(cmsis_dir, 'core_cm3.h'), 'wb') as f:
+        f.write(patch_core_cm3(text).encode('latin-1'))
+    # 源文件包含"sysTick.h"，实际文件名为SysTick.h（Windows下不区分大小写）
+    shutil.copy(os.path.join(BOOT_DIR, 'Core', 'Inc', 'SysTick.h'), os.path.join(cmsis_dir, 'sysTick.h'))
+
+    # bsp_usart.c以引号包含同目录的bsp_usart.h，两者一起复制
+    usart_src = os.path.join(BOOT_DIR, 'BSP', 'USART')
+    shutil.copy(os.path.join(usart_src, 'bsp_usart.c'), usart_dir)
+    with open(os.path.join(usart_src, 'bsp_usart.h'), 'rb') as f:
+        text = f.read().decode('latin-1')
+    if irq_mode:
+        text = re.sub(r'(#define\s+DEBUG_USART_(?:RX|TX)_DMA\s+)1', r'\g<1>0', text)
+    with open(os.path.join(usart_dir, 'bsp_usart.h'), 'wb') as f:
+        f.write(text.encode('latin-1'))
+
+    with open(os.path.join(workdir, 'node.c'), 'w') as f:
+        f.write(C_NODE_SOURCE)
+    return [cmsis_dir, usart_dir]
+
+
+def build_node(workdir, irq_mode):
+    """编译节点程序，返回可执行文件路径，没有C编译器返回None"""
+    cc = shutil.which('cc') or shutil.which('gcc')
+    if cc is None:
+        return None
+
+    include_dirs = prepare_sources(workdir, irq_mode) + [os.path.join(BOOT_DIR, d) for d in BOOT_INCLUDES]
+    sources = [os.path.join(workdir, 'node.c'), os.path.join(workdir, 'usart', 'bsp_usart.c')]
+    sources += [os.path.join(BOOT_DIR, s) for s in BOOT_SOURCES]
+    exe = os.path.join(workdir, 'node')
+
+    # 外设和DMA地址寄存器为32位，不生成位置无关代码，保证全局变量地址在4GB以内
+    cflags = [cc, '-O1', '-g', '-std=gnu99', '-no-pie',
+              '-DSTM32F10X_MD', '-DUSE_STDPERIPH_DRIVER', '-DCRC32_USE_HW=0',
+              '-Wno-int-to-pointer-cast', '-Wno-pointer-to-int-cast']
+    cflags += [f'-I{d}' for d in include_dirs]
+    objects = []
+    for src in sources:
+        obj = os.path.join(workdir, os.path.splitext(os.path.basename(src))[0] + '.o')
+        extra = ['-Dymodem_process=ymodem_process_target'] if src.endswith('ymodem.c') else []
+        subprocess.check_call(cflags + extra + ['-c', src, '-o', obj])
+        objects.append(obj)
+    subprocess.check_call(cflags + objects + ['-o', exe])
+    return exe
+
+
+class SimBus:
+    """半双工多机总线：主机发出的数据送到所有节点，节点发出的数据送到主机和其他节点
+
+    送往节点的数据按段发送，每段前加2字节长度（小端），节点每次中断收一段后置线路空闲，
+    这样节点即使没有及时调度，也能按线路上的实际间隔区分各发送方的帧。
+    """
+
+    CHUNK = 32
+
+    def __init__(self, count):
+        self.masters = []
+        self.slaves = []
+        for _ in range(count):
+            master, slave = os.openpty()
+            tty.setraw(slave)
+            self.masters.append(master)
+            self.slaves.append(slave)
+        self.host_rx = bytearray()
+        self.cond = threading.Condition()
+        self.write_lock = threading.Lock()
+        self.running = True
+        # 故障注入：(节点序号, 第几个1024字节数据包)，该节点收到的这个包被破坏
+        self.corrupt = None
+        self.data_packets = 0
+        self.thread = threading.Thread(target=self.relay, daemon=True)
+        self.thread.start()
+
+    def tty_name(self, index):
+        return os.ttyname(self.slaves[index])
+
+    @staticmethod
+    def write_all(fd, data):
+        view = memoryview(data)
+        while view:
+            view = view[os.write(fd, view):]
+
+    def send_burst(self, parts):
+        """把线路上的一段数据同时送到各节点，parts为(伪终端, 数据)列表；
+        整段加锁，保证每个节点看到的各发送方的数据顺序相同"""
+        with self.write_lock:
+            for master, part in parts:
+                self.write_all(master, struct.pack('<H', len(part)) + part)
+
+    def host_write(self, data, baudrate):
+        """主机发送：按波特率分段送上总线（每字节10位），节点按实际线路速率接收"""
+        data = bytes(data)
+        targets = [data] * len(self.masters)
+        if len(data) == 1029:
+            self.data_packets += 1
+            if self.corrupt is not None and self.corrupt[1] == self.data_packets:
+                bad = bytearray(data)
+                bad[100] ^= 0xFF
+                targets[self.corrupt[0]] = bytes(bad)
+
+        deadline = time.monotonic()
+        for pos in range(0, len(data), self.CHUNK):
+            self.send_burst([(master, target[pos:pos + self.CHUNK])
+                             for master, target in zip(self.masters, targets)])
+            deadline += len(data[pos:pos + self.CHUNK]) * 10 / baudrate
+            delay = deadline - time.monotonic()
+            if delay > 0:
+                time.sleep(delay)
+
+    def relay(self):
+        while self.running:
+            ready, _, _ = select.select(self.masters, [], [], 0.05)
+            for master in ready:
+                try:
+                    data = os.read(master, 4096)
+                except OSError:
+                    continue
+                for pos in range(0, len(data), self.CHUNK):
+                    self.send_burst([(other, data[pos:pos + self.CHUNK])
+                                     for other in self.masters if other != master])
+                with self.cond:
+                    self.host_rx += data
+                    self.cond.notify_all()
+
+    def close(self):
+        self.running = False
+        self.thread.join()
+        for fd in self.masters + self.slaves:
+            os.close(fd)
+
+
+class SimSerialPort:
+    """主机端串口：接口与firmware_update.py用到的serial.Serial部分一致，收发经过仿真总线"""
+
+    def __init__(self, bus):
+        self.bus = bus
+        self.timeout = 1
+        self.baudrate = 115200
+        self.is_open = True
+
+    @property
+    def in_waiting(self):
+        return len(self.bus.host_rx)
+
+    def write(self, data):
+        self.bus.host_write(data, self.baudrate)
+        return len(data)
+
+    def read(self, size=1):
+        deadline = time.monotonic() + (self.timeout if self.timeout is not None else 1e9)
+        with self.bus.cond:
+            while len(self.bus.host_rx) < size:
+                remaining = deadline - time.monotonic()
+                if remaining <= 0:
+                    break
+                self.bus.cond.wait(remaining)
+            data = bytes(self.bus.host_rx[:size])
+            del self.bus.host_rx[:size]
+        return data
+
+    def flush(self):
+        pass
+
+    def reset_input_buffer(self):
+        with self.bus.cond:
+            self.bus.host_rx.clear()
+
+    def reset_output_buffer(self):
+        pass
+
+    def close(self):
+        self.is_open = False
+
+
+def import_updater():
+    """导入firmware_update.py；没有安装pyserial时用空模块代替（仿真不需要真实串口）"""
+    sys.path.insert(0, TOOLS_DIR)
+    try:
+        import serial  # noqa: F401
+    except ImportError:
+        sys.modules['serial'] = types.ModuleType('serial')
+    import firmware_packer
+    import firmware_update
+    return firmware_packer, firmware_update
+
+
+def make_firmware(workdir, packer_module):
+    """生成测试固件包：随机数据中间夹一整页0xFF，首字不是有效栈指针，升级后不会真的跳转"""
+    app = bytearray(os.urandom(13 * 1024 + 300))
+    app[0:4] = b'\x00\x00\x00\x00'
+    app[5 * 1024:6 * 1024] = b'\xff' * 1024
+    bin_file = os.path.join(workdir, 'app.bin')
+    pkg_file = os.path.join(workdir, 'app_pkg.bin')
+    with open(bin_file, 'wb') as f:
+        f.write(app)
+    with contextlib.redirect_stdout(io.StringIO()):
+        if not packer_module.FirmwarePacker().pack_firmware(bin_file, '1.2.3', pkg_file):
+            raise RuntimeError('固件打包失败')
+    return pkg_file
+
+
+def check_node(node_id, output, image_file, package):
+    """核对节点结果，返回错误描述列表"""
+    errors = []
+    match = re.search(r'node=(\d+) active=(\d+) status=(\d+) de=(\d+) de_errors=(\d+) rx_dropped=(\d+)', output)
+    if not match:
+        return [f'没有结果输出: {output.strip()!r}']
+    active, status, de, de_errors, rx_dropped = (int(v) for v in match.groups()[1:])
+    if status != UPGRADE_STATUS_SUCCESS:
+        errors.append(f'升级状态 {status}')
+    if de != 0:
+        errors.append('结束后DE仍为高（未释放总线）')
+    if de_errors:
+        errors.append(f'DE为低时发出 {de_errors} 字节')
+    if rx_dropped:
+        errors.append(f'DE为高期间丢失 {rx_dropped} 字节')
+    with open(image_file, 'rb') as f:
+        image = f.read()
+    offset = APP_BANK_ADDR[active] - FLASH_BASE
+    if image[offset:offset + len(package)] != package:
+        errors.append(f'{"AB"[active]}区内容与固件包不一致')
+    return errors
+
+
+def run(count, irq_mode):
+    packer_module, updater_module = import_updater()
+
+    with tempfile.TemporaryDirectory() as workdir:
+        exe = build_node(workdir, irq_mode)
+        if exe is None:
+            print("未找到C编译器，无法运行仿真")
+            return False
+        package_file = make_firmware(workdir, packer_module)
+        with open(package_file, 'rb') as f:
+            package = f.read()
+
+        nodes = list(range(1, count + 1))
+        bus = SimBus(count)
+        # 第二个节点（只有一个节点时为第一个）漏收第二个数据包，由查询位图后补发
+        bus.corrupt = (min(1, count - 1), 2)
+        images = [os.path.join(workdir, f'flash_{n}.bin') for n in nodes]
+        procs = [subprocess.Popen([exe, bus.tty_name(i), str(n), images[i]],
+                                  stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+                 for i, n in enumerate(nodes)]
+        # 节点进入升级流程后才开始发送（真实总线上节点早已上电等待）
+        for proc in procs:
+            proc.stdout.readline()
+        time.sleep(0.1)
+
+        sender = updater_module.SimpleYModemSender()
+        sender.serial_port = SimSerialPort(bus)
+        start = time.monotonic()
+        try:
+            ok, message = sender.send_file_fleet(package_file, nodes, log_callback=lambda m: print(f"  {m}"))
+        finally:
+            outputs = []
+            for proc in procs:
+                try:
+                    outputs.append(proc.communicate(timeout=5)[0])
+                except subprocess.TimeoutExpired:
+                    proc.kill()
+                    outputs.append(proc.communicate()[0])
+            bus.close()
+        elapsed = time.monotonic() - start
+
+        print(f"发送结果: {message}，耗时 {elapsed:.2f} s")
+        passed = ok
+        for i, n in enumerate(nodes):
+            errors = check_node(n, outputs[i], images[i], package)
+            print(f"节点 {n}: {'通过' if not errors else '失败 - ' + '; '.join(errors)}")
+            passed = passed and not errors
+        return passed
+
+
+def main():
+    args = [a for a in sys.argv[1:] if not a.startswith('--')]
+    irq_mode = '--irq' in sys.argv[1:]
+    count = int(args[0]) if args else 3
+
+    print("=" * 50)
+    print(f"多机总线仿真：{count} 个节点，串口{'中断' if irq_mode else 'DMA'}收发")
+    print("=" * 50)
+    ok = run(count, irq_mode)
+    print("-" * 50)
+    print("全部节点升级成功" if ok else "错误：仿真升级失败！")
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()